@@ -0,0 +1,38 @@
+/* Forest Benchmark:
+ * Measures batch bonsai generation throughput (trees/sec and cubes/sec) on
+ * 1 .. N threads, usage: ./bench/forest [trees] [max threads]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+
+#include "../src/forest/forest.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  size_t trees = (argc > 1) ? strtoull(argv[1], NULL, 10) : 20000;
+  unsigned int maxThreads = (argc > 2) ? atoi(argv[2])
+                                       : thread::hardware_concurrency();
+
+  cout << "threads,trees/sec,cubes/sec,speedup" << endl;
+  double baseline = 0.0;
+  for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+    ThreadPool pool(threads);
+    atomic<size_t> cubes(0);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    growForest(0, trees, pool,
+               [&cubes](size_t, Bonsai &tree) { cubes += tree.cubeCount(); });
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    double treesPerSec = trees / elapsed.count();
+    if (threads == 1)
+      baseline = treesPerSec;
+    cout << threads << "," << treesPerSec << "," << cubes / elapsed.count()
+         << "," << treesPerSec / baseline << endl;
+  }
+  return 0;
+}
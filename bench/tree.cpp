@@ -0,0 +1,75 @@
+/* Tree Benchmark:
+ * Measures how growing a single bonsai scales over 1 .. N threads, with its
+ * big sub-branches forked onto a pool (trees/sec, and speedup over a pool of
+ * one thread and over growing without a pool), and checks the trees match
+ * one grown serially
+ * usage: ./bench/tree [species] [seed] [repeats] [max threads]
+ * - species is a preset name (see params.h), giant by default
+ */
+
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+
+#include "../src/bonsai/bonsai.h"
+
+using namespace std;
+
+// returns whether two trees hold the same cubes in the same order
+bool sameTree(const Bonsai &a, const Bonsai &b) {
+  for (int m = 0; m < VOXEL_MATERIALS; m++) {
+    if (a.Voxels[m].size() != b.Voxels[m].size())
+      return false;
+    for (size_t i = 0; i < a.Voxels[m].size(); i++) {
+      if (a.Voxels[m][i].Position != b.Voxels[m][i].Position ||
+          a.Voxels[m][i].Data != b.Voxels[m][i].Data)
+        return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  const Bonsai_Params *params = findPreset((argc > 1) ? argv[1] : "giant");
+  if (!params) {
+    cout << "Unknown species: " << argv[1] << endl;
+    return 1;
+  }
+  uint64_t seed = (argc > 2) ? strtoull(argv[2], NULL, 10) : 0;
+  size_t repeats = (argc > 3) ? strtoull(argv[3], NULL, 10) : 50;
+  unsigned int maxThreads = (argc > 4) ? atoi(argv[4])
+                                       : thread::hardware_concurrency();
+
+  // serial growth, warmed up first
+  Bonsai serial(seed, *params);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < repeats; i++)
+    Bonsai tree(seed, *params);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  double serialPerSec = repeats / elapsed.count();
+  cout << "cubes: " << serial.cubeCount() << endl;
+  cout << "serial trees/sec: " << serialPerSec << endl;
+
+  cout << "threads,trees/sec,speedup,vs serial,identical" << endl;
+  double baseline = 0.0;
+  for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+    ThreadPool pool(threads);
+    Bonsai warmup(seed, pool, *params);
+    bool identical = true;
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < repeats; i++) {
+      Bonsai tree(seed, pool, *params);
+      identical = identical && sameTree(tree, serial);
+    }
+    elapsed = chrono::steady_clock::now() - start;
+
+    double treesPerSec = repeats / elapsed.count();
+    if (threads == 1)
+      baseline = treesPerSec;
+    cout << threads << "," << treesPerSec << "," << treesPerSec / baseline
+         << "," << treesPerSec / serialPerSec << ","
+         << (identical ? "yes" : "no") << endl;
+  }
+  return 0;
+}
@@ -1,152 +1,515 @@
 /* Bonsai Class:
  * Contains the algorithm for generating a bonsai using cubes
+ * - a tree can be grown serially, step by step, or on a ThreadPool with big
+ *   sub-branches forked off as tasks of their own (see grow(ThreadPool &))
  * -- Hao X. July 2021
  */
 
 #ifndef BONSAI_H
 #define BONSAI_H
 
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <memory>
+#include <stdint.h>
 #include <vector>
 
+#include "../pool/pool.h"
+#include "leaves.h"
+#include "occupancy.h"
+#include "params.h"
+#include "random.h"
+#include "voxel.h"
+#include "voxelset.h"
+
 // constants -------------------------------------------------------------------
-// branch parameters
-const unsigned int Y_GROWTH = 8;
-const unsigned int MAX_XZ_GROWTH = 3;
-const unsigned int BRANCH_COOLDOWN = 2;
-const unsigned int BRANCHES_TIERS = 4;
+// species parameters (branches, pot, leaves) are given per tree, see params.h
 
-// pot parameters
-const int MAX_POT_DEPTH = 4;
-const int POT_RADIUS = 3;
+// parallel growth: sub-branches of this tier or above are forked onto the
+// pool, smaller ones are too cheap to be worth a task and stay serial
+const int PARALLEL_TIER = 2;
 
-// leaf parameters
-int LEAF_HEIGHT = 3;
-int LEAF_RADIUS = 6;
+// animation parameters
+// - every cube carries the tick (frame) it is born on, the vertex shader then
+//   scales cubes in once the current tick passes their birth tick
+// - the pot is planted first (bottom-up), then the soil, then the tree grows
+const unsigned int CUBE_TICKS = 3; // ticks between neighbouring cubes
 
 class Bonsai {
 public:
   // attributes ----------------------------------------------------------------
-  std::vector<glm::vec3> BranchPositions;
-  std::vector<glm::vec3> LeafPositions;
-  std::vector<glm::vec3> PotPositions;
-  std::vector<glm::vec3> SoilPositions;
+  // cubes of each material, indexed by Voxel_Material (e.g. Voxels[LEAF])
+  std::vector<Voxel> Voxels[VOXEL_MATERIALS];
+
+  // number of overlapping cubes dropped while generating, per material
+  size_t Duplicates[VOXEL_MATERIALS];
+
+  // bounding box (kept up to date while growing) and per-material bit grid
+  // of every cube (built once the tree is fully grown)
+  Occupancy Grid;
+
+  // constructors --------------------------------------------------------------
+  // 1. construct a new, random tree
+  Bonsai() : Bonsai(randomSeed()) {}
+
+  // 2. construct the tree grown from a seed, the same seed (and species)
+  //    gives the same tree
+  Bonsai(uint64_t seed,
+         const Bonsai_Params &params = BONSAI_PRESETS[0].Params)
+      : Bonsai(seed, true, params) {}
+
+  // 3. construct from a seed, but only grow the tree if 'growNow' is set
+  // - an ungrown tree is cheap and can be grown later using grow()
+  Bonsai(uint64_t seed, bool growNow,
+         const Bonsai_Params &params = BONSAI_PRESETS[0].Params)
+      : params(params), seed(seed), pool(NULL) {
+    for (int m = 0; m < VOXEL_MATERIALS; m++)
+      Duplicates[m] = 0;
+
+    // the worklist is a stack, so the last task pushed runs first
+    // - the tree (with xz axis directions -1, 0 or 1), then pot, then soil
+    // - the trunk draws from stream 0 of the seed, every branch from its own
+    push(Task(SOIL_TASK, glm::ivec3(0, -1, 0), params.PotRadius));
+    push(Task(POT_TASK, glm::ivec3(0, -1, 0), 0));
+    Random trunk(seed);
+    int xdir = trunk.range(3) - 1, zdir = trunk.range(3) - 1;
+    push(Task(TREE_TASK, glm::ivec3(0, 0, 0), params.YGrowth,
+              params.BranchTiers, xdir, zdir, treeBirth(), trunk));
+
+    if (growNow)
+      grow();
+  }
+
+  // 4. construct the tree grown from a seed on a pool (same tree as 2.)
+  Bonsai(uint64_t seed, ThreadPool &pool,
+         const Bonsai_Params &params = BONSAI_PRESETS[0].Params)
+      : Bonsai(seed, false, params) {
+    grow(pool);
+  }
+
+  // functions -----------------------------------------------------------------
+  // grows the tree by running at most 'steps' tasks from its worklist
+  // - returns true once the tree is fully grown
+  // - growth can be suspended and resumed at any step, the finished tree is
+  //   always identical to one grown in a single call
+  bool grow(size_t steps = SIZE_MAX) {
+    if (grown())
+      return true;
+    run(steps);
+    if (!worklist.empty())
+      return false;
+    finish();
+    return true;
+  }
+
+  // grows the rest of the tree on a pool, every sub-branch of PARALLEL_TIER
+  // or above grows as a task of its own, into its own buffers
+  // - the buffers are then merged in the order serial growth would have
+  //   placed the cubes in, so the tree is identical to one grown serially
+  //   (each branch draws from its own random stream, see random.h)
+  // - call from outside the pool's tasks, it waits for them all
+  void grow(ThreadPool &pool) {
+    if (grown())
+      return;
+    this->pool = &pool;
+    run(SIZE_MAX);
+    pool.wait();
+    this->pool = NULL;
+    merge(pool);
+    finish();
+  }
+
+  // returns whether the tree is fully grown
+  bool grown() const { return worklist.empty(); }
 
-  // constructor ---------------------------------------------------------------
-  Bonsai() {
-    // generate bonsai tree with xz axis directions (-1, 0 or 1)
-    int xdir = rand() % 3 - 1, zdir = rand() % 3 - 1;
-    generateTree(glm::vec3(0, 0, 0), Y_GROWTH, BRANCHES_TIERS, xdir, zdir);
+  // returns the seed this tree was grown from
+  uint64_t getSeed() const { return seed; }
 
-    // generate pot
-    generatePot(glm::vec3(0, -1, 0), 0);
+  // returns the parameters of the species this tree was grown as
+  const Bonsai_Params &getParams() const { return params; }
 
-    // generate soil
-    generateSoil(glm::vec3(0, -1, 0), POT_RADIUS);
+  // returns the total number of cubes over all materials
+  size_t cubeCount() const {
+    size_t count = 0;
+    for (int m = 0; m < VOXEL_MATERIALS; m++)
+      count += Voxels[m].size();
+    return count;
   }
 
 private:
-  // recursively generates a voxel-based bonsai tree ---------------------------
+  // a pending piece of generation, replaces a recursive call
+  // - TREE_TASK: one growth step of a branch (pos, growth, tier, xdir, zdir)
+  // - LEAVES_TASK: one layer of foliage (pos, height, radius)
+  // - POT_TASK: one layer of the pot (pos, depth)
+  // - SOIL_TASK: the soil patch (pos, radius)
+  // - tree and leaves tasks carry the random stream of their branch, which
+  //   the branch's follow-up tasks continue drawing from
+  enum Task_Type { TREE_TASK, LEAVES_TASK, POT_TASK, SOIL_TASK };
+  struct Task {
+    Task_Type Type;
+    glm::ivec3 Pos;
+    int A, B, Xdir, Zdir; // growth & tier, height & radius, depth, radius
+    unsigned int Birth;
+    Random Rng;
+    Task(Task_Type type, glm::ivec3 pos, int a, int b = 0, int xdir = 0,
+         int zdir = 0, unsigned int birth = 0, const Random &rng = Random())
+        : Type(type), Pos(pos), A(a), B(b), Xdir(xdir), Zdir(zdir),
+          Birth(birth), Rng(rng) {}
+  };
+
+  // a sub-branch grown on the pool, as a tree of its own holding just that
+  // branch, and where its cubes go once merged
+  struct Fork {
+    size_t At[VOXEL_MATERIALS]; // cubes of each material grown before it
+    std::shared_ptr<Bonsai> Branch;
+  };
+
+  // a run of cubes of one branch, in the order they are merged in
+  struct Run {
+    const Voxel *First;
+    size_t Count;
+  };
+
+  // species parameters (a copy, so callers may change or free theirs) and
+  // the seed keying every random stream of the tree
+  Bonsai_Params params;
+  uint64_t seed;
+
+  // tasks still to run, at most a few per branch tier deep
+  std::vector<Task> worklist;
+
+  // cubes placed so far per material, branches and leaves overlap a lot
+  VoxelSet placed[VOXEL_MATERIALS];
+
+  // pool sub-branches are forked onto (only while growing on a pool), and the
+  // sub-branches forked off so far, in the order they were forked
+  ThreadPool *pool;
+  std::vector<Fork> forks;
+
+  // construct a tree holding just the sub-branch 'branch', grown by run()
+  Bonsai(const Bonsai_Params &params, uint64_t seed, const Task &branch,
+         ThreadPool *pool)
+      : params(params), seed(seed), pool(pool) {
+    for (int m = 0; m < VOXEL_MATERIALS; m++)
+      Duplicates[m] = 0;
+    push(branch);
+  }
+
+  void push(const Task &task) { worklist.push_back(task); }
+
+  // ticks the soil and then the tree start growing on, once the pot (and
+  // then the soil) has been planted
+  unsigned int soilBirth() const {
+    return (params.MaxPotDepth + 1) * 4 * CUBE_TICKS;
+  }
+  unsigned int treeBirth() const {
+    return soilBirth() + (params.PotRadius + 1) * CUBE_TICKS;
+  }
+
+  // runs at most 'steps' tasks from the worklist
+  void run(size_t steps) {
+    for (; steps > 0 && !worklist.empty(); steps--) {
+      Task task = worklist.back();
+      worklist.pop_back();
+      switch (task.Type) {
+      case TREE_TASK:
+        generateTree(task);
+        break;
+      case LEAVES_TASK:
+        generateLeaves(task);
+        break;
+      case POT_TASK:
+        generatePot(task);
+        break;
+      case SOIL_TASK:
+        generateSoil(task);
+        break;
+      }
+    }
+  }
+
+  // wraps up a fully grown tree, duplicate tracking is only needed while
+  // growing (a merged tree's grid is already built, see merge())
+  void finish() {
+    for (int m = 0; m < VOXEL_MATERIALS; m++) {
+      Duplicates[m] = placed[m].Duplicates;
+      placed[m].clear();
+    }
+    std::vector<Task>().swap(worklist);
+    if (!Grid.built())
+      Grid.build(Voxels);
+  }
+
+  // grows a sub-branch as a task of its own on the pool, its cubes are
+  // slotted in after every cube grown so far once the tree is merged (a
+  // serial growth would grow the sub-branch next, see generateTree)
+  void fork(const Task &branch) {
+    Fork fork;
+    for (int m = 0; m < VOXEL_MATERIALS; m++)
+      fork.At[m] = Voxels[m].size();
+    fork.Branch =
+        std::shared_ptr<Bonsai>(new Bonsai(params, seed, branch, pool));
+    forks.push_back(fork);
+    Bonsai *tree = fork.Branch.get();
+    pool->submit([tree]() { tree->run(SIZE_MAX); });
+  }
+
+  // replaces the cubes with those of the whole tree, forked sub-branches
+  // included, once every sub-branch has grown
+  // - duplicates between branches are dropped with the tree's occupancy grid
+  //   (built here instead of by finish()), the first cube in serial order
+  //   wins
+  // - the grid is split into slabs along y, each marked on the pool by a
+  //   task of its own: every task walks the cubes in order but only tests
+  //   and sets the cells of its slab, so no two tasks share a grid word
+  void merge(ThreadPool &pool) {
+    if (forks.empty())
+      return;
+    std::vector<Run> runs[VOXEL_MATERIALS];
+    size_t counts[VOXEL_MATERIALS] = {};
+    collect(runs, counts, Grid);
+    Grid.allocate();
+
+    std::vector<unsigned char> kept[VOXEL_MATERIALS];
+    for (int m = 0; m < VOXEL_MATERIALS; m++)
+      kept[m].resize(counts[m]);
+    int height = Grid.size(1);
+    int slabs = std::min(height, pool.size() > 1 ? (int)pool.size() * 4 : 1);
+    for (int slab = 0; slab < slabs; slab++) {
+      int lo = Grid.Min.y + height * slab / slabs;
+      int hi = Grid.Min.y + height * (slab + 1) / slabs;
+      pool.submit([this, &runs, &kept, lo, hi]() {
+        for (int m = 0; m < VOXEL_MATERIALS; m++)
+          mark(runs[m], lo, hi, m, kept[m].data());
+      });
+    }
+    pool.wait();
+
+    // keep the marked cubes, the rest were placed by an earlier branch
+    for (int m = 0; m < VOXEL_MATERIALS; m++) {
+      std::vector<Voxel> merged(counts[m]);
+      size_t i = 0, k = 0;
+      for (size_t r = 0; r < runs[m].size(); r++) {
+        for (size_t j = 0; j < runs[m][r].Count; j++, i++) {
+          merged[k] = runs[m][r].First[j];
+          k += kept[m][i];
+        }
+      }
+      merged.resize(k);
+      placed[m].Duplicates += counts[m] - k;
+      Voxels[m].swap(merged);
+    }
+
+    // the sub-branches' buffers are freed on the pool as well
+    for (size_t f = 0; f < forks.size(); f++) {
+      std::shared_ptr<Bonsai> branch;
+      branch.swap(forks[f].Branch);
+      pool.submit([branch]() mutable { branch.reset(); });
+    }
+    forks.clear();
+    pool.wait();
+  }
+
+  // lists the cubes of this tree and of its sub-branches as runs in serial
+  // (depth-first) order, counting them in 'counts'
+  // - every branch already dropped its own duplicates, those are added to
+  //   this tree's count, and its bounding box is included in 'grid'
+  void collect(std::vector<Run> *runs, size_t *counts, Occupancy &grid) {
+    size_t from[VOXEL_MATERIALS] = {};
+    for (size_t f = 0; f <= forks.size(); f++) {
+      for (int m = 0; m < VOXEL_MATERIALS; m++) {
+        size_t to = (f < forks.size()) ? forks[f].At[m] : Voxels[m].size();
+        if (to > from[m]) {
+          Run run = {&Voxels[m][from[m]], to - from[m]};
+          runs[m].push_back(run);
+          counts[m] += run.Count;
+        }
+        from[m] = to;
+      }
+      if (f < forks.size()) {
+        Bonsai &branch = *forks[f].Branch;
+        branch.collect(runs, counts, grid);
+        for (int m = 0; m < VOXEL_MATERIALS; m++)
+          placed[m].Duplicates += branch.placed[m].Duplicates;
+      }
+    }
+    if (!Grid.empty()) {
+      grid.include(Grid.Min);
+      grid.include(Grid.Max);
+    }
+  }
+
+  // sets kept[i] for every cube i of the runs with y in [lo, hi) whose cell
+  // was not set in the grid yet (by an earlier cube), setting it
+  void mark(const std::vector<Run> &runs, int lo, int hi, int material,
+            unsigned char *kept) {
+    for (size_t r = 0; r < runs.size(); r++) {
+      const Voxel *voxels = runs[r].First;
+      for (size_t j = 0; j < runs[r].Count; j++, kept++) {
+        glm::ivec3 cell = voxels[j].cell();
+        if (cell.y >= lo && cell.y < hi)
+          *kept = Grid.set(cell, material);
+      }
+    }
+  }
+
+  // generates one growth step of a voxel-based bonsai branch ------------------
   // - generates branch cubes based on chance and a degenerating growth rate
-  // - using rand() to generate numbers is sufficient as % the result
+  // - using rng.range() to generate numbers is sufficient as % the result
+  // - a new branch forks its own random stream off this one, so what it
+  //   draws does not depend on the order branches are grown in
   // - to maintain a realistic branch structure, ea. branch is segmented into
   //   tiers wherein the lower the tier, the more likely it is to branch
-  void generateTree(glm::vec3 pos, int growth, int tier, int xdir, int zdir) {
+  // - birth is the tick the next cube of this branch is born on, so sibling
+  //   branches grow at the same time rather than one after the other
+  // - the rest of the branch is pushed as a follow-up task, and a new branch
+  //   is pushed on top of it, so it is grown first (depth-first, like the
+  //   recursive algorithm this replaces)
+  void generateTree(Task &task) {
+    Random &rng = task.Rng;
+    glm::ivec3 pos = task.Pos;
+    int growth = task.A, tier = task.B, xdir = task.Xdir, zdir = task.Zdir;
+    unsigned int birth = task.Birth;
 
     // base case: on smallest branch -> now generate foliage
     if (tier == 0) {
-      generateLeaves(pos, LEAF_HEIGHT, LEAF_RADIUS);
-      return;
+      push(Task(LEAVES_TASK, pos, params.LeafHeight, params.LeafRadius, 0, 0,
+                birth, rng));
 
-      // recursive case: branch tier finished growing, move to lower tier
+      // branch tier finished growing, move to lower tier
     } else if (growth == 0) {
-      generateTree(pos, pow(2, (tier - 1)), tier - 1, xdir, zdir);
+      push(Task(TREE_TASK, pos, 1 << (tier - 1), tier - 1, xdir, zdir, birth,
+                rng));
 
-      // recursive case: continue generating current tier
+      // continue generating current tier
     } else {
-      glm::vec3 npos = pos;
+      glm::ivec3 npos = pos;
 
       // randomly generate horizontal movement, 1 axis at a time
-      for (unsigned int i = 0; i < MAX_XZ_GROWTH; i++) {
-        if (rand() % 2 == 0)
-          npos += glm::vec3(xdir * (rand() % 2), 0, 0);
+      for (unsigned int i = 0; i < params.MaxXzGrowth; i++) {
+        if (rng.range(2) == 0)
+          npos += glm::ivec3(xdir * rng.range(2), 0, 0);
         else
-          npos += glm::vec3(0, 0, zdir * (rand() % 2));
-        BranchPositions.push_back(npos);
+          npos += glm::ivec3(0, 0, zdir * rng.range(2));
+        addCube(BRANCH, npos, birth);
+        birth += CUBE_TICKS;
       }
 
       // lastly add upward movement
-      npos += glm::vec3(0, 1, 0);
-      BranchPositions.push_back(npos);
+      npos += glm::ivec3(0, 1, 0);
+      addCube(BRANCH, npos, birth);
+      birth += CUBE_TICKS;
 
-      // (random) chance to make a new branch depending on tier
-      if (growth % BRANCH_COOLDOWN == 0 && rand() % tier == 0) {
-        generateBranch(npos, growth, tier, xdir, zdir);
-      }
+      // continue making branch (after any new branch)
+      // - the new branch is decided first, the follow-up must carry the
+      //   stream on from after the fork
+      bool branch = growth % params.BranchCooldown == 0 &&
+                    rng.range(tier) == 0;
+      Random sub = branch ? rng.fork() : Random();
+      push(Task(TREE_TASK, npos, growth - 1, tier, xdir, zdir, birth, rng));
 
-      // continue making branch
-      generateTree(npos, growth - 1, tier, xdir, zdir);
+      // (random) chance to make a new branch depending on tier
+      if (branch)
+        generateBranch(npos, tier, xdir, zdir, birth, sub);
     }
   }
 
   // creates a new branch with a new direction and tier-proportionate growth
-  void generateBranch(glm::vec3 pos, int growth, int tier, int xdir, int zdir) {
-    int nxdir = chooseNewDirection(xdir), nzdir = chooseNewDirection(zdir);
-    if (nxdir || nzdir)
-      generateTree(pos, pow(2, (tier - 1)), tier - 1, nxdir, nzdir);
+  // - rng is the new branch's own stream, forked off its parent's
+  // - while growing on a pool, a big enough branch is forked off as a task
+  void generateBranch(glm::ivec3 pos, int tier, int xdir, int zdir,
+                      unsigned int birth, Random &rng) {
+    int nxdir = chooseNewDirection(xdir, rng);
+    int nzdir = chooseNewDirection(zdir, rng);
+    if (!nxdir && !nzdir)
+      return;
+    Task branch(TREE_TASK, pos, 1 << (tier - 1), tier - 1, nxdir, nzdir, birth,
+                rng);
+    if (pool && tier - 1 >= PARALLEL_TIER)
+      fork(branch);
+    else
+      push(branch);
   }
 
-  // recursively generates bonsai leaves
-  void generateLeaves(glm::vec3 pos, int height, int radius) {
+  // generates one layer of bonsai leaves, then pushes the next (smaller) one
+  // - leaves sprout outwards from the branch tip, one layer after another
+  // - the further away from the centre the less likely a leaf spawns, the
+  //   cells of the disc are sampled in batches (see leaves.h)
+  void generateLeaves(Task &task) {
+    Random &rng = task.Rng;
+    glm::ivec3 pos = task.Pos;
+    int height = task.A, radius = task.B;
+    unsigned int birth = task.Birth;
     if (!height)
       return;
-    else {
-      // create circular cross-section on xz plane
-      for (int x = -radius; x <= radius; x++) {
-        for (int z = -radius; z <= radius; z++) {
-          if (x * x + z * z <= radius * radius)
-            // the further away from the centre the less likely a leaf spawns
-            if ((x != 0 || z != 0) && rand() % (abs(x) + abs(z)) == 0)
-              LeafPositions.push_back(pos + glm::vec3(x, 1, z));
-        }
-      }
+
+    // create circular cross-section on xz plane
+    LeafDisc large;
+    const LeafDisc *disc = leafDisc(radius);
+    if (!disc) {
+      large = LeafDisc(radius);
+      disc = &large;
     }
-    generateLeaves(pos + glm::vec3(0, 1, 0), height - 1, radius - 2);
+    sampleLeaves(disc->Thresholds.data(), disc->Cells.size(), rng,
+                 [&](size_t i) {
+                   const Leaf_Cell &cell = disc->Cells[i];
+                   addCube(LEAF, pos + glm::ivec3(cell.X, 1, cell.Z),
+                           birth + cell.Distance * CUBE_TICKS);
+                 });
+    push(Task(LEAVES_TASK, pos + glm::ivec3(0, 1, 0), height - 1, radius - 2,
+              0, 0, task.Birth + CUBE_TICKS, rng));
   }
 
-  // recursively generates a circular pot with xy curvature defined by quadratic
-  void generatePot(glm::vec3 pos, int depth) {
+  // generates one layer of a circular pot with xy curvature defined by a
+  // quadratic, then pushes the next layer down
+  void generatePot(const Task &task) {
+    glm::ivec3 pos = task.Pos;
+    int depth = task.A;
     int y = pos.y, radius = -0.5 * ((y - 1) * (y + 6)); // calc radius using y
-    if (depth == MAX_POT_DEPTH)
+    if (depth == params.MaxPotDepth)
       return;
-    else {
-      // create circular cross-section on xz plane
-      for (int x = -radius; x <= radius; x++) {
-        for (int z = -radius; z <= radius; z++) {
-          if (x * x + z * z <= radius * radius)
-            PotPositions.push_back(pos + glm::vec3(x, 0, z));
-        }
+
+    // pot is planted bottom-up, one layer at a time
+    unsigned int birth = (params.MaxPotDepth - depth) * 4 * CUBE_TICKS;
+
+    // create circular cross-section on xz plane
+    for (int x = -radius; x <= radius; x++) {
+      for (int z = -radius; z <= radius; z++) {
+        if (x * x + z * z <= radius * radius)
+          addCube(POT, pos + glm::ivec3(x, 0, z), birth);
       }
-      generatePot(pos + glm::vec3(0, -1, 0), depth + 1);
     }
+    push(Task(POT_TASK, pos + glm::ivec3(0, -1, 0), depth + 1));
   }
 
   // generate circular soil patch with centre position 'pos'
-  void generateSoil(glm::vec3 pos, int radius) {
+  void generateSoil(const Task &task) {
+    int radius = task.A;
     for (int x = -radius; x <= radius; x++) {
       for (int z = -radius; z <= radius; z++) {
         if (x * x + z * z <= radius * radius)
-          SoilPositions.push_back(pos + glm::vec3(x, 0, z));
+          addCube(SOIL, task.Pos + glm::ivec3(x, 0, z),
+                  soilBirth() + (abs(x) + abs(z)) * CUBE_TICKS);
       }
     }
   }
 
+  // adds a cube with its birth tick, unless the material already has a cube
+  // at that position
+  void addCube(Voxel_Material material, glm::ivec3 pos, unsigned int birth) {
+    Voxel voxel(pos, birth, material);
+    if (placed[material].insert(voxel.Position)) {
+      Voxels[material].push_back(voxel);
+      Grid.include(pos);
+    }
+  }
+
   // randomly choose a direction different to the previous for a an axis
-  int chooseNewDirection(int dir) {
+  int chooseNewDirection(int dir, Random &rng) {
     // guard against 0 x/z direction to so branch doesn't degenerate to an
     // upward stick if we were to only flip the x/z direction
-    int randint = rand() % 2;
+    int randint = rng.range(2);
     if (dir == 0)
       return (randint == 0) ? -1 : 1;
     else
@@ -0,0 +1,173 @@
+/* Leaf Sampling:
+ * Foliage layers of a bonsai as precomputed disc stencils, with the leaf
+ * trial of every cell done in batches
+ * - the cells of a disc (its centre excluded) are listed once per radius, in
+ *   the order x then z, each with the threshold its random number must not
+ *   exceed to sprout a leaf (a chance of 1 in |x| + |z|)
+ * - a layer draws one 32-bit number per cell in a single batch (see
+ *   Random::fill), compares them with the thresholds 8 (AVX2) or 4 (SSE2) at
+ *   a time and packs the indices of the accepted cells, with a scalar
+ *   fallback elsewhere, all accepting the same cells
+ */
+
+#ifndef LEAVES_H
+#define LEAVES_H
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "random.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LEAVES_SSE2
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#define LEAVES_AVX2
+#endif
+
+// constants -------------------------------------------------------------------
+// discs of a smaller radius are built once and shared by every tree
+const int LEAF_DISC_RADII = 32;
+
+// cells sampled per batch, a multiple of 16 so batches draw back to back
+const size_t LEAF_BATCH = 256;
+
+// structs ---------------------------------------------------------------------
+// a cell of a foliage layer, relative to the branch tip
+struct Leaf_Cell {
+  int X, Z;
+  int Distance; // |x| + |z|
+};
+
+// indices of the set bits of every 8-bit mask, in order, and their count
+struct Leaf_Pack_Table {
+  uint8_t Order[256][8];
+  uint8_t Count[256];
+};
+
+// functions -------------------------------------------------------------------
+// returns the largest random number that sprouts a leaf 'distance' cells
+// away from the centre, i.e. with a chance of 1 in distance
+constexpr uint32_t leafThreshold(int distance) {
+  return UINT32_MAX / (uint32_t)distance;
+}
+
+// returns the pack table, built once
+inline const Leaf_Pack_Table &leafPack() {
+  static const Leaf_Pack_Table table = []() {
+    Leaf_Pack_Table built = {};
+    for (int mask = 0; mask < 256; mask++) {
+      int count = 0;
+      for (int bit = 0; bit < 8; bit++) {
+        if ((mask >> bit) & 1)
+          built.Order[mask][count++] = bit;
+      }
+      built.Count[mask] = count;
+    }
+    return built;
+  }();
+  return table;
+}
+
+// class -----------------------------------------------------------------------
+// every cell of a disc in structure-of-arrays form
+class LeafDisc {
+public:
+  // attributes ----------------------------------------------------------------
+  std::vector<Leaf_Cell> Cells;
+  std::vector<uint32_t> Thresholds;
+
+  // constructor ---------------------------------------------------------------
+  LeafDisc(int radius = 0) {
+    for (int x = -radius; x <= radius; x++) {
+      for (int z = -radius; z <= radius; z++) {
+        if (x * x + z * z <= radius * radius && (x != 0 || z != 0)) {
+          Leaf_Cell cell = {x, z, abs(x) + abs(z)};
+          Cells.push_back(cell);
+          Thresholds.push_back(leafThreshold(cell.Distance));
+        }
+      }
+    }
+  }
+};
+
+// functions -------------------------------------------------------------------
+// returns the shared disc of a radius below LEAF_DISC_RADII, NULL otherwise
+inline const LeafDisc *leafDisc(int radius) {
+  static const std::vector<LeafDisc> discs = []() {
+    std::vector<LeafDisc> discs;
+    for (int radius = 0; radius < LEAF_DISC_RADII; radius++)
+      discs.push_back(LeafDisc(radius));
+    return discs;
+  }();
+  if (radius < 0)
+    return &discs[0];
+  return (radius < LEAF_DISC_RADII) ? &discs[radius] : NULL;
+}
+
+// writes the index of every i with numbers[i] <= thresholds[i] to 'accepted'
+// (room for 'count'), in order, returns how many were accepted
+inline size_t acceptLeaves(const uint32_t *numbers, const uint32_t *thresholds,
+                           size_t count, uint32_t *accepted) {
+  size_t kept = 0, i = 0;
+#if defined(LEAVES_AVX2) || defined(LEAVES_SSE2)
+  const Leaf_Pack_Table &pack = leafPack();
+#endif
+#ifdef LEAVES_AVX2
+  // unsigned compare by flipping the sign bits, then pack the indices of the
+  // accepted lanes with a permute (writes 8 indices, only 'kept' are kept)
+  __m256i sign = _mm256_set1_epi32(INT32_MIN);
+  for (; i + 8 <= count; i += 8) {
+    __m256i u = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i *)(numbers + i)), sign);
+    __m256i t = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i *)(thresholds + i)), sign);
+    __m256i rejected = _mm256_cmpgt_epi32(u, t);
+    int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(rejected)) & 255;
+    __m256i order = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i *)pack.Order[mask]));
+    _mm256_storeu_si256((__m256i *)(accepted + kept),
+                        _mm256_add_epi32(order, _mm256_set1_epi32((int)i)));
+    kept += pack.Count[mask];
+  }
+#endif
+#ifdef LEAVES_SSE2
+  __m128i sign4 = _mm_set1_epi32(INT32_MIN);
+  for (; i + 4 <= count; i += 4) {
+    __m128i u = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(numbers + i)), sign4);
+    __m128i t = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(thresholds + i)), sign4);
+    __m128i rejected = _mm_cmpgt_epi32(u, t);
+    int mask = ~_mm_movemask_ps(_mm_castsi128_ps(rejected)) & 15;
+    for (int j = 0; j < 4; j++)
+      accepted[kept + j] = i + pack.Order[mask][j];
+    kept += pack.Count[mask];
+  }
+#endif
+  for (; i < count; i++) {
+    accepted[kept] = i;
+    kept += numbers[i] <= thresholds[i];
+  }
+  return kept;
+}
+
+// runs the leaf trials of 'count' cells with the given thresholds, calling
+// place(i) for every cell i that sprouts a leaf, in order
+template <typename Place>
+void sampleLeaves(const uint32_t *thresholds, size_t count, Random &rng,
+                  Place place) {
+  uint32_t numbers[LEAF_BATCH], accepted[LEAF_BATCH];
+  for (size_t first = 0; first < count; first += LEAF_BATCH) {
+    size_t batch = std::min(LEAF_BATCH, count - first);
+    rng.fill(numbers, batch);
+    size_t kept = acceptLeaves(numbers, thresholds + first, batch, accepted);
+    for (size_t i = 0; i < kept; i++)
+      place(first + accepted[i]);
+  }
+}
+#endif
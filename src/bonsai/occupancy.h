@@ -0,0 +1,167 @@
+/* Occupancy Class:
+ * Dense bit grid over a bonsai's bounding box, one bit per cell and per
+ * material layer, for O(1) "is this cell occupied" queries
+ * - rows run along x and are packed into 64-bit words, so neighbour tests
+ *   along a row (or between rows) can be done 64 cells at a time
+ */
+
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <climits>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include "voxel.h"
+
+// constants -------------------------------------------------------------------
+// layer holding the union of every material layer
+const int OCCUPANCY_ANY = VOXEL_MATERIALS;
+
+// functions -------------------------------------------------------------------
+// index of the lowest set bit of a non-zero word, e.g. to walk the cells of
+// a row word
+inline int lowestBit(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(word);
+#else
+  int bit = 0;
+  while (!((word >> bit) & 1))
+    bit++;
+  return bit;
+#endif
+}
+
+// class -----------------------------------------------------------------------
+class Occupancy {
+public:
+  // attributes ----------------------------------------------------------------
+  // inclusive bounding box of every cube (Min > Max while empty)
+  glm::ivec3 Min;
+  glm::ivec3 Max;
+
+  // constructor ---------------------------------------------------------------
+  Occupancy() : Min(INT_MAX), Max(INT_MIN), rowWords(0) {}
+
+  // functions -----------------------------------------------------------------
+  // grows the bounding box to contain a cell
+  void include(glm::ivec3 cell) {
+    Min = glm::min(Min, cell);
+    Max = glm::max(Max, cell);
+  }
+
+  // allocates an empty grid for the current bounding box
+  void allocate() {
+    if (empty())
+      return;
+    rowWords = (size(0) + 63) / 64;
+    bits.assign((size_t)(VOXEL_MATERIALS + 1) * layerWords(), 0);
+  }
+
+  // allocates the grid for the current bounding box and sets every voxel's bit
+  void build(const std::vector<Voxel> *voxels) {
+    allocate();
+    for (int m = 0; m < VOXEL_MATERIALS; m++) {
+      for (size_t i = 0; i < voxels[m].size(); i++)
+        set(voxels[m][i].cell(), m);
+    }
+  }
+
+  // sets the bit of a cell (inside the box) in a material's layer and in the
+  // union, returns false if the material's bit was already set
+  bool set(glm::ivec3 cell, int material) {
+    glm::ivec3 c = cell - Min;
+    uint64_t bit = 1ULL << (c.x & 63);
+    size_t w = rowIndex(c.y, c.z) * rowWords + (c.x >> 6);
+    uint64_t &word = bits[material * layerWords() + w];
+    if (word & bit)
+      return false;
+    word |= bit;
+    bits[OCCUPANCY_ANY * layerWords() + w] |= bit;
+    return true;
+  }
+
+  // whether the grid has been allocated
+  bool built() const { return !bits.empty(); }
+
+  // frees the grid (the bounding box is kept)
+  void clear() {
+    std::vector<uint64_t>().swap(bits);
+    rowWords = 0;
+  }
+
+  bool empty() const { return Min.x > Max.x; }
+
+  // number of cells along an axis (0 = x, 1 = y, 2 = z)
+  int size(int axis) const { return empty() ? 0 : Max[axis] - Min[axis] + 1; }
+
+  // number of 64-bit words per row along x
+  int words() const { return rowWords; }
+
+  bool inside(glm::ivec3 cell) const {
+    return cell.x >= Min.x && cell.y >= Min.y && cell.z >= Min.z &&
+           cell.x <= Max.x && cell.y <= Max.y && cell.z <= Max.z;
+  }
+
+  // whether a cell holds a cube of any material, or of the given layer
+  bool test(glm::ivec3 cell, int layer = OCCUPANCY_ANY) const {
+    if (!inside(cell) || bits.empty())
+      return false;
+    glm::ivec3 c = cell - Min;
+    return (row(layer, c.y, c.z)[c.x >> 6] >> (c.x & 63)) & 1;
+  }
+
+  // word 'w' of the row at box-relative (y, z), 0 outside of the box
+  // - bit i of word w is the cell at x = Min.x + w * 64 + i
+  uint64_t word(int layer, int y, int z, int w) const {
+    if (y < 0 || z < 0 || y >= size(1) || z >= size(2) || w < 0 ||
+        w >= rowWords || bits.empty())
+      return 0;
+    return row(layer, y, z)[w];
+  }
+
+  // cells of word 'w' of row (y, z) that hold a cube of the layer and whose
+  // neighbour towards 'face' is empty (of any material)
+  // - face = axis * 2 + (0 for the negative side, 1 for the positive side)
+  uint64_t exposed(int face, int layer, int y, int z, int w) const {
+    uint64_t cells = word(layer, y, z, w);
+    uint64_t any = word(OCCUPANCY_ANY, y, z, w), neighbours;
+    switch (face) {
+    case 0: // -x, carry the last bit in from the previous word
+      neighbours = (any << 1) | (word(OCCUPANCY_ANY, y, z, w - 1) >> 63);
+      break;
+    case 1: // +x, carry the first bit in from the next word
+      neighbours = (any >> 1) | (word(OCCUPANCY_ANY, y, z, w + 1) << 63);
+      break;
+    case 2:
+      neighbours = word(OCCUPANCY_ANY, y - 1, z, w);
+      break;
+    case 3:
+      neighbours = word(OCCUPANCY_ANY, y + 1, z, w);
+      break;
+    case 4:
+      neighbours = word(OCCUPANCY_ANY, y, z - 1, w);
+      break;
+    default:
+      neighbours = word(OCCUPANCY_ANY, y, z + 1, w);
+      break;
+    }
+    return cells & ~neighbours;
+  }
+
+private:
+  std::vector<uint64_t> bits; // layers of rows of words
+  int rowWords;
+
+  size_t layerWords() const {
+    return (size_t)size(1) * size(2) * rowWords;
+  }
+
+  size_t rowIndex(int y, int z) const { return (size_t)y * size(2) + z; }
+
+  const uint64_t *row(int layer, int y, int z) const {
+    return &bits[layer * layerWords() + rowIndex(y, z) * rowWords];
+  }
+};
+#endif
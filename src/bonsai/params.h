@@ -0,0 +1,58 @@
+/* Bonsai Parameters:
+ * Everything that shapes a species of bonsai, copied into every tree grown
+ * from it (see bonsai.h), along with a few named presets
+ * - parameters are plain values owned by each tree, so trees of different
+ *   species can be grown on different threads at the same time
+ */
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <string.h>
+
+// structs ---------------------------------------------------------------------
+struct Bonsai_Params {
+  // branch parameters
+  unsigned int YGrowth;        // growth steps of the trunk
+  unsigned int MaxXzGrowth;    // horizontal moves per growth step
+  unsigned int BranchCooldown; // growth steps between chances to branch
+  unsigned int BranchTiers;    // tiers of ever smaller branches
+
+  // pot parameters
+  int MaxPotDepth; // layers of the pot
+  int PotRadius;   // radius of the soil patch on top
+
+  // leaf parameters
+  int LeafHeight; // layers of foliage at the tip of every branch
+  int LeafRadius; // radius of the lowest layer, shrinks by 2 per layer
+};
+
+struct Bonsai_Preset {
+  const char *Name;
+  Bonsai_Params Params;
+};
+
+// constants -------------------------------------------------------------------
+// named species, the first is the default
+// - giant: far more tiers of branches, the number of branches (and cubes)
+//   grows exponentially with them, best grown on a pool (see Bonsai)
+const Bonsai_Preset BONSAI_PRESETS[] = {
+    // name      growth  xz  cooldown  tiers  pot depth & radius  leaves
+    {"classic", {8, 3, 2, 4, 4, 3, 3, 6}},
+    {"shrub", {4, 2, 2, 3, 4, 3, 2, 5}},
+    {"windswept", {6, 5, 1, 4, 4, 3, 2, 7}},
+    {"giant", {16, 3, 2, 7, 4, 3, 3, 6}},
+};
+const int BONSAI_PRESET_COUNT =
+    sizeof(BONSAI_PRESETS) / sizeof(BONSAI_PRESETS[0]);
+
+// functions -------------------------------------------------------------------
+// returns the parameters of the preset with the given name, NULL if none
+inline const Bonsai_Params *findPreset(const char *name) {
+  for (int i = 0; i < BONSAI_PRESET_COUNT; i++) {
+    if (strcmp(BONSAI_PRESETS[i].Name, name) == 0)
+      return &BONSAI_PRESETS[i].Params;
+  }
+  return NULL;
+}
+#endif
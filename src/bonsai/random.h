@@ -0,0 +1,236 @@
+/* Random Class:
+ * Counter-based pseudo-random number generator (Philox4x32-10) owned by every
+ * branch of a bonsai, so trees are reproducible from a seed and can be
+ * generated on several threads without sharing libc's locked rand() state
+ * - the n-th number of a stream is a pure function of (seed, stream, n), so
+ *   there is no state to pass from one branch to the next
+ * - a branch forks a new stream for every sub-branch it spawns, the stream ID
+ *   being derived from the parent's stream and the point of the fork, so
+ *   each branch draws the same numbers no matter when or where it is grown
+ * - batches of 32-bit numbers compute 4 (SSE2) or 8 (AVX2) blocks at once,
+ *   with a scalar fallback elsewhere, all giving the same numbers
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <chrono>
+#include <random>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RANDOM_SSE2
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#define RANDOM_AVX2
+#endif
+
+// constants -------------------------------------------------------------------
+// Philox4x32 multipliers and key increments
+const uint32_t PHILOX_M0 = 0xD2511F53u, PHILOX_M1 = 0xCD9E8D57u;
+const uint32_t PHILOX_W0 = 0x9E3779B9u, PHILOX_W1 = 0xBB67AE85u;
+
+// class -----------------------------------------------------------------------
+class Random {
+public:
+  // constructor ---------------------------------------------------------------
+  // - seed is the key shared by every stream of a tree, stream picks one of
+  //   its 2^64 independent sequences
+  Random(uint64_t seed = 0, uint64_t stream = 0)
+      : seed(seed), stream(stream), position(0), cached(UINT64_MAX) {}
+
+  // functions -----------------------------------------------------------------
+  // returns the next 64 random bits
+  // - every Philox block yields 128 bits, i.e. two numbers
+  uint64_t next() {
+    uint64_t index = position >> 1;
+    if (index != cached) {
+      philox(index, block);
+      cached = index;
+    }
+    const uint32_t *half = block + (position & 1) * 2;
+    position++;
+    return ((uint64_t)half[0] << 32) | half[1];
+  }
+
+  // fills 'words' with the next 'count' 32-bit random numbers
+  // - numbers come in groups of 16 from 4 consecutive blocks, number 4j + l
+  //   of a group being word j of the group's block l (the layout SIMD
+  //   computes them in), starting at the next whole block
+  // - whole groups are consumed, so batches of a multiple of 16 numbers
+  //   follow on from each other without gaps
+  void fill(uint32_t *words, size_t count) {
+    uint64_t index = (position + 1) >> 1;
+    size_t groups = (count + 15) / 16, g = 0;
+    position = (index + groups * 4) * 2;
+#ifdef RANDOM_AVX2
+    for (; (g + 2) * 16 <= count; g += 2)
+      philox8(index + g * 4, words + g * 16);
+#endif
+    for (; g < groups; g++) {
+      // a partial last group is computed into a buffer
+      uint32_t group[16];
+      uint32_t *out = ((g + 1) * 16 <= count) ? words + g * 16 : group;
+#ifdef RANDOM_SSE2
+      philox4(index + g * 4, out);
+#else
+      for (int l = 0; l < 4; l++) {
+        uint32_t words4[4];
+        philox(index + g * 4 + l, words4);
+        for (int j = 0; j < 4; j++)
+          out[j * 4 + l] = words4[j];
+      }
+#endif
+      if (out == group)
+        memcpy(words + g * 16, group, (count - g * 16) * sizeof(uint32_t));
+    }
+  }
+
+  // returns a number in [0, n), n must be positive
+  // - bias of a 64-bit modulo is negligible for the small n used here
+  int range(int n) { return (int)(next() % (uint64_t)n); }
+
+  // returns the generator of a new, independent stream (e.g. of a sub-branch)
+  // - the child's stream ID hashes this stream's ID with the current position,
+  //   which then advances, so every fork of a stream differs
+  Random fork() {
+    uint64_t child = stream ^ splitmix64(position++ + 0x9e3779b97f4a7c15ULL);
+    return Random(seed, splitmix64(child));
+  }
+
+  // returns the ID of the stream being drawn from
+  uint64_t getStream() const { return stream; }
+
+private:
+  uint64_t seed, stream, position;
+  uint64_t cached;   // block index held in 'block'
+  uint32_t block[4]; // output of the last Philox block
+
+  // computes the Philox4x32-10 block with counter (index, stream) into
+  // 'out', 10 rounds of multiply-xorshift pass all of BigCrush
+  void philox(uint64_t index, uint32_t *out) const {
+    uint32_t c[4] = {(uint32_t)index, (uint32_t)(index >> 32),
+                     (uint32_t)stream, (uint32_t)(stream >> 32)};
+    uint32_t k[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+    for (int round = 0; round < 10; round++) {
+      uint64_t p0 = (uint64_t)PHILOX_M0 * c[0];
+      uint64_t p1 = (uint64_t)PHILOX_M1 * c[2];
+      uint32_t n[4] = {(uint32_t)(p1 >> 32) ^ c[1] ^ k[0], (uint32_t)p1,
+                       (uint32_t)(p0 >> 32) ^ c[3] ^ k[1], (uint32_t)p0};
+      for (int i = 0; i < 4; i++)
+        c[i] = n[i];
+      k[0] += PHILOX_W0;
+      k[1] += PHILOX_W1;
+    }
+    for (int i = 0; i < 4; i++)
+      out[i] = c[i];
+  }
+
+#ifdef RANDOM_SSE2
+  // computes the blocks index .. index + 3 into a group (see fill()), one
+  // block per lane
+  void philox4(uint64_t index, uint32_t *out) const {
+    __m128i c[4] = {_mm_setr_epi32((int)index, (int)(index + 1),
+                                   (int)(index + 2), (int)(index + 3)),
+                    _mm_setr_epi32((int)(index >> 32), (int)((index + 1) >> 32),
+                                   (int)((index + 2) >> 32),
+                                   (int)((index + 3) >> 32)),
+                    _mm_set1_epi32((int)stream),
+                    _mm_set1_epi32((int)(stream >> 32))};
+    uint32_t k[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+    for (int round = 0; round < 10; round++) {
+      __m128i hi0, lo0, hi1, lo1;
+      mulhilo(c[0], PHILOX_M0, hi0, lo0);
+      mulhilo(c[2], PHILOX_M1, hi1, lo1);
+      c[0] = _mm_xor_si128(_mm_xor_si128(hi1, c[1]), _mm_set1_epi32(k[0]));
+      c[1] = lo1;
+      c[2] = _mm_xor_si128(_mm_xor_si128(hi0, c[3]), _mm_set1_epi32(k[1]));
+      c[3] = lo0;
+      k[0] += PHILOX_W0;
+      k[1] += PHILOX_W1;
+    }
+    for (int j = 0; j < 4; j++)
+      _mm_storeu_si128((__m128i *)(out + j * 4), c[j]);
+  }
+
+  // high and low halves of the 64-bit products of every lane with m
+  static void mulhilo(__m128i a, uint32_t m, __m128i &hi, __m128i &lo) {
+    __m128i mv = _mm_set1_epi32(m);
+    __m128i even = _mm_mul_epu32(a, mv);                    // lanes 0, 2
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), mv); // lanes 1, 3
+    lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(2, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(2, 0, 2, 0)));
+    hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 3, 1)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#endif
+
+#ifdef RANDOM_AVX2
+  // computes the blocks index .. index + 7 into two groups (see fill())
+  void philox8(uint64_t index, uint32_t *out) const {
+    __m256i offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i low = _mm256_add_epi32(_mm256_set1_epi32((int)index), offsets);
+    // the high word carries wherever the low word wrapped around
+    __m256i carry = _mm256_cmpgt_epi32(
+        _mm256_xor_si256(_mm256_set1_epi32((int)index),
+                         _mm256_set1_epi32(INT32_MIN)),
+        _mm256_xor_si256(low, _mm256_set1_epi32(INT32_MIN)));
+    __m256i c[4] = {low,
+                    _mm256_sub_epi32(_mm256_set1_epi32((int)(index >> 32)),
+                                     carry),
+                    _mm256_set1_epi32((int)stream),
+                    _mm256_set1_epi32((int)(stream >> 32))};
+    uint32_t k[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+    for (int round = 0; round < 10; round++) {
+      __m256i hi0, lo0, hi1, lo1;
+      mulhilo(c[0], PHILOX_M0, hi0, lo0);
+      mulhilo(c[2], PHILOX_M1, hi1, lo1);
+      c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, c[1]),
+                              _mm256_set1_epi32(k[0]));
+      c[1] = lo1;
+      c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, c[3]),
+                              _mm256_set1_epi32(k[1]));
+      c[3] = lo0;
+      k[0] += PHILOX_W0;
+      k[1] += PHILOX_W1;
+    }
+    // blocks 0 .. 3 in the lower half, 4 .. 7 in the upper
+    for (int j = 0; j < 4; j++) {
+      _mm_storeu_si128((__m128i *)(out + j * 4), _mm256_castsi256_si128(c[j]));
+      _mm_storeu_si128((__m128i *)(out + 16 + j * 4),
+                       _mm256_extracti128_si256(c[j], 1));
+    }
+  }
+
+  static void mulhilo(__m256i a, uint32_t m, __m256i &hi, __m256i &lo) {
+    __m256i mv = _mm256_set1_epi32(m);
+    __m256i even = _mm256_mul_epu32(a, mv);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), mv);
+    lo = _mm256_unpacklo_epi32(
+        _mm256_shuffle_epi32(even, _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm256_shuffle_epi32(odd, _MM_SHUFFLE(2, 0, 2, 0)));
+    hi = _mm256_unpacklo_epi32(
+        _mm256_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 3, 1)),
+        _mm256_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#endif
+
+  static uint64_t splitmix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+};
+
+// functions -------------------------------------------------------------------
+// returns a fresh, non-deterministic seed for a new tree
+inline uint64_t randomSeed() {
+  std::random_device device;
+  uint64_t seed = ((uint64_t)device() << 32) ^ device();
+  return seed ^ (uint64_t)std::chrono::high_resolution_clock::now()
+                    .time_since_epoch()
+                    .count();
+}
+#endif
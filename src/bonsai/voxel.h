@@ -0,0 +1,83 @@
+/* Voxel Struct:
+ * Compact, 8 byte representation of a bonsai cube used from generation all
+ * the way to the GPU
+ * - position: integer x, y, z packed as signed 10 bit fields, bit-compatible
+ *   with OpenGL's GL_INT_2_10_10_10_REV vertex format (range -512 .. 511)
+ * - data: birth tick (upper 24 bits) and material (lower 8 bits)
+ */
+
+#ifndef VOXEL_H
+#define VOXEL_H
+
+#include <assert.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+// constants & enums -----------------------------------------------------------
+// bonsai materials, also the index of their cube list in a Bonsai
+enum Voxel_Material { BRANCH, LEAF, SOIL, POT };
+const int VOXEL_MATERIALS = 4;
+
+// largest birth tick a voxel can store
+const unsigned int VOXEL_MAX_BIRTH = (1u << 24) - 1;
+
+// range of every cube coordinate a voxel can store
+const int VOXEL_MIN_COORD = -512, VOXEL_MAX_COORD = 511;
+
+// struct ----------------------------------------------------------------------
+struct Voxel {
+  // attributes ----------------------------------------------------------------
+  uint32_t Position;
+  uint32_t Data;
+
+  // constructors --------------------------------------------------------------
+  Voxel() : Position(0), Data(0) {}
+  // - out of range coordinates would wrap onto another cube and a late birth
+  //   would overwrite the material, so both are asserted to fit
+  Voxel(glm::ivec3 cell, unsigned int birth, Voxel_Material material)
+      : Position(pack(cell)), Data((birth << 8) | material) {
+    assert(fits(cell) && birth <= VOXEL_MAX_BIRTH);
+  }
+
+  // functions -----------------------------------------------------------------
+  // integer cube coordinates
+  glm::ivec3 cell() const {
+    // shift each field to the top, then arithmetic shift back to sign extend
+    return glm::ivec3((int32_t)(Position << 22) >> 22,
+                      (int32_t)(Position << 12) >> 22,
+                      (int32_t)(Position << 2) >> 22);
+  }
+
+  // cube centre as a float vector, for code that still wants glm::vec3
+  glm::vec3 position() const {
+    glm::ivec3 c = cell();
+    return glm::vec3(c.x, c.y, c.z);
+  }
+
+  unsigned int birth() const { return Data >> 8; }
+  Voxel_Material material() const { return (Voxel_Material)(Data & 0xFF); }
+
+  // returns whether integer cube coordinates can be packed without wrapping
+  static bool fits(glm::ivec3 cell) {
+    return cell.x >= VOXEL_MIN_COORD && cell.x <= VOXEL_MAX_COORD &&
+           cell.y >= VOXEL_MIN_COORD && cell.y <= VOXEL_MAX_COORD &&
+           cell.z >= VOXEL_MIN_COORD && cell.z <= VOXEL_MAX_COORD;
+  }
+
+  // packs integer cube coordinates into 10 bits per axis
+  static uint32_t pack(glm::ivec3 cell) {
+    return ((uint32_t)cell.x & 0x3FF) | (((uint32_t)cell.y & 0x3FF) << 10) |
+           (((uint32_t)cell.z & 0x3FF) << 20);
+  }
+};
+
+// functions -------------------------------------------------------------------
+// converts a list of voxels into cube centres
+inline std::vector<glm::vec3> toPositions(const std::vector<Voxel> &voxels) {
+  std::vector<glm::vec3> positions(voxels.size());
+  for (size_t i = 0; i < voxels.size(); i++)
+    positions[i] = voxels[i].position();
+  return positions;
+}
+#endif
@@ -0,0 +1,76 @@
+/* VoxelSet Class:
+ * Open-addressing (linear probing) hash set of packed voxel positions (see
+ * voxel.h), used to drop duplicate cubes while a bonsai is generated
+ */
+
+#ifndef VOXELSET_H
+#define VOXELSET_H
+
+#include <stdint.h>
+#include <vector>
+
+// constants -------------------------------------------------------------------
+// marks an unused slot, packed positions never set the top 2 bits
+const uint32_t VOXELSET_EMPTY = ~0u;
+
+// class -----------------------------------------------------------------------
+class VoxelSet {
+public:
+  // attributes ----------------------------------------------------------------
+  size_t Size;       // number of distinct positions inserted
+  size_t Duplicates; // number of inserts rejected as duplicates
+
+  // constructor ---------------------------------------------------------------
+  VoxelSet() : Size(0), Duplicates(0) {}
+
+  // functions -----------------------------------------------------------------
+  // inserts a packed position, returns false (and counts it) if present
+  bool insert(uint32_t key) {
+    if ((Size + 1) * 2 > slots.size())
+      rehash(slots.empty() ? 1024 : slots.size() * 2);
+    if (!place(slots, key)) {
+      Duplicates++;
+      return false;
+    }
+    Size++;
+    return true;
+  }
+
+  // forgets every position and releases memory (the duplicate count is kept)
+  void clear() {
+    std::vector<uint32_t>().swap(slots);
+    Size = 0;
+  }
+
+private:
+  std::vector<uint32_t> slots; // size is always a power of two
+
+  // inserts a key into a slot table, returns false if it is already there
+  static bool place(std::vector<uint32_t> &table, uint32_t key) {
+    size_t mask = table.size() - 1;
+    for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+      if (table[i] == key)
+        return false;
+      if (table[i] == VOXELSET_EMPTY) {
+        table[i] = key;
+        return true;
+      }
+    }
+  }
+
+  // grows the slot table, re-inserting every key
+  void rehash(size_t capacity) {
+    std::vector<uint32_t> table(capacity, VOXELSET_EMPTY);
+    for (size_t i = 0; i < slots.size(); i++) {
+      if (slots[i] != VOXELSET_EMPTY)
+        place(table, slots[i]);
+    }
+    slots.swap(table);
+  }
+
+  // fibonacci hashing, spreads neighbouring keys over the whole table
+  static size_t hash(uint32_t key) {
+    return (size_t)(((uint64_t)key * 0x9e3779b97f4a7c15ULL) >> 32);
+  }
+};
+#endif
@@ -0,0 +1,130 @@
+/* Clusters Class:
+ * Groups a bonsai's cubes by the chunk of a coarse grid they fall in, so
+ * whole chunks can be culled by their bounding box
+ * - cubes are reordered so every cluster is one contiguous range, visible
+ *   clusters can then be drawn as a few instance ranges
+ */
+
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "../bonsai/bonsai.h"
+#include "frustum.h"
+
+// constants -------------------------------------------------------------------
+// side length of a cluster's chunk in cells
+const int CLUSTER_SIZE = 8;
+
+// structs ---------------------------------------------------------------------
+// a range of cubes in Clusters::Voxels
+struct Cluster_Range {
+  unsigned int First;
+  unsigned int Count;
+  Cluster_Range(unsigned int first, unsigned int count)
+      : First(first), Count(count) {}
+};
+
+// class -----------------------------------------------------------------------
+class Clusters {
+public:
+  // attributes ----------------------------------------------------------------
+  // every cube of the tree (all materials), grouped by cluster
+  std::vector<Voxel> Voxels;
+
+  // cluster i holds Voxels[First[i]] .. Voxels[First[i + 1] - 1]
+  std::vector<unsigned int> First;
+
+  // cluster bounding boxes in world space, one array per coordinate
+  std::vector<float> MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+
+  // constructors --------------------------------------------------------------
+  // 1. construct without any clusters
+  Clusters() {}
+
+  // 2. construct the clusters of a fully grown tree
+  Clusters(const Bonsai &tree) {
+    const Occupancy &grid = tree.Grid;
+    if (grid.empty())
+      return;
+    int dims[3];
+    for (int a = 0; a < 3; a++)
+      dims[a] = (grid.size(a) + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+    // counting sort of the cubes by chunk, stable so cubes keep their order
+    std::vector<unsigned int> chunkOf, start(dims[0] * dims[1] * dims[2] + 1);
+    for (int m = 0; m < VOXEL_MATERIALS; m++) {
+      for (size_t i = 0; i < tree.Voxels[m].size(); i++) {
+        glm::ivec3 c = (tree.Voxels[m][i].cell() - grid.Min) / CLUSTER_SIZE;
+        chunkOf.push_back((c.y * dims[2] + c.z) * dims[0] + c.x);
+        start[chunkOf.back() + 1]++;
+      }
+    }
+    for (size_t k = 1; k < start.size(); k++)
+      start[k] += start[k - 1];
+    Voxels.resize(chunkOf.size());
+    std::vector<unsigned int> next(start.begin(), start.end() - 1);
+    size_t index = 0;
+    for (int m = 0; m < VOXEL_MATERIALS; m++) {
+      for (size_t i = 0; i < tree.Voxels[m].size(); i++)
+        Voxels[next[chunkOf[index++]]++] = tree.Voxels[m][i];
+    }
+
+    // a cluster per non-empty chunk, bounded tightly by its cubes
+    for (size_t k = 0; k + 1 < start.size(); k++) {
+      if (start[k] == start[k + 1])
+        continue;
+      glm::ivec3 lo = Voxels[start[k]].cell(), hi = lo;
+      for (unsigned int i = start[k] + 1; i < start[k + 1]; i++) {
+        lo = glm::min(lo, Voxels[i].cell());
+        hi = glm::max(hi, Voxels[i].cell());
+      }
+      First.push_back(start[k]);
+      MinX.push_back(lo.x - 0.5f);
+      MinY.push_back(lo.y - 0.5f);
+      MinZ.push_back(lo.z - 0.5f);
+      MaxX.push_back(hi.x + 0.5f);
+      MaxY.push_back(hi.y + 0.5f);
+      MaxZ.push_back(hi.z + 0.5f);
+    }
+    First.push_back(Voxels.size());
+  }
+
+  // functions -----------------------------------------------------------------
+  // returns the number of clusters
+  size_t size() const { return MinX.size(); }
+
+  // returns whether cluster i passed frustum culling in the last cull()
+  bool inFrustum(size_t i) const { return i < visible.size() && visible[i]; }
+
+  // replaces 'ranges' with the cube ranges of every cluster in the frustum
+  // - clusters with skip[i] set (e.g. occluded ones) are left out as well
+  // - neighbouring visible clusters are merged into one range
+  void cull(const Frustum &frustum, std::vector<Cluster_Range> &ranges,
+            const unsigned char *skip = NULL) const {
+    ranges.clear();
+    visible.resize(size());
+    if (visible.empty())
+      return;
+    frustum.cull(&MinX[0], &MinY[0], &MinZ[0], &MaxX[0], &MaxY[0], &MaxZ[0],
+                 size(), &visible[0]);
+    for (size_t i = 0; i < size(); i++) {
+      if (!visible[i] || (skip && skip[i]))
+        continue;
+      unsigned int count = First[i + 1] - First[i];
+      if (!ranges.empty() &&
+          ranges.back().First + ranges.back().Count == First[i])
+        ranges.back().Count += count;
+      else
+        ranges.push_back(Cluster_Range(First[i], count));
+    }
+  }
+
+private:
+  // per-cluster culling results, kept to avoid reallocating every frame
+  mutable std::vector<unsigned char> visible;
+};
+#endif
@@ -0,0 +1,91 @@
+/* Frustum Class:
+ * The six planes of a camera's view volume, used to cull bounding boxes
+ * - boxes are tested four at a time with SSE where available (every x86-64
+ *   compiler has it), with a scalar fallback elsewhere
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+// class -----------------------------------------------------------------------
+class Frustum {
+public:
+  // attributes ----------------------------------------------------------------
+  // planes (normal xyz, distance w) with normals pointing inwards, in the
+  // order left, right, bottom, top, near, far
+  glm::vec4 Planes[6];
+
+  // constructor ---------------------------------------------------------------
+  // - viewProjection is projection * view, planes are then in world space
+  Frustum(const glm::mat4 &viewProjection) {
+    // rows of the (column-major) matrix
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+      row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                         viewProjection[2][i], viewProjection[3][i]);
+    for (int i = 0; i < 3; i++) {
+      Planes[i * 2] = row[3] + row[i];
+      Planes[i * 2 + 1] = row[3] - row[i];
+    }
+  }
+
+  // functions -----------------------------------------------------------------
+  // returns whether part of a box lies behind the near plane, which is also
+  // the case whenever the eye is inside the box
+  bool crossesNear(glm::vec3 lo, glm::vec3 hi) const {
+    // the box corner furthest against the normal decides
+    const glm::vec4 &n = Planes[4];
+    float d = n.x * (n.x > 0.0f ? lo.x : hi.x) +
+              n.y * (n.y > 0.0f ? lo.y : hi.y) +
+              n.z * (n.z > 0.0f ? lo.z : hi.z) + n.w;
+    return d < 0.0f;
+  }
+
+  // culls 'count' boxes given as separate min/max coordinate arrays
+  // - visible[i] is set to whether box i is (at least partly) inside, boxes
+  //   that merely straddle a corner outside the frustum may pass too
+  void cull(const float *minX, const float *minY, const float *minZ,
+            const float *maxX, const float *maxY, const float *maxZ,
+            size_t count, unsigned char *visible) const {
+    size_t i = 0;
+#ifdef FRUSTUM_SSE
+    for (; i + 4 <= count; i += 4) {
+      __m128 outside = _mm_setzero_ps();
+      for (int p = 0; p < 6; p++) {
+        // the box corner furthest along the normal decides, if even that is
+        // behind the plane the whole box is
+        const glm::vec4 &n = Planes[p];
+        __m128 x = _mm_loadu_ps((n.x > 0.0f ? maxX : minX) + i);
+        __m128 y = _mm_loadu_ps((n.y > 0.0f ? maxY : minY) + i);
+        __m128 z = _mm_loadu_ps((n.z > 0.0f ? maxZ : minZ) + i);
+        __m128 d = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(n.x)),
+                       _mm_mul_ps(y, _mm_set1_ps(n.y))),
+            _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(n.z)), _mm_set1_ps(n.w)));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+      }
+      int mask = _mm_movemask_ps(outside);
+      for (int j = 0; j < 4; j++)
+        visible[i + j] = !(mask & (1 << j));
+    }
+#endif
+    for (; i < count; i++) {
+      visible[i] = true;
+      for (int p = 0; p < 6 && visible[i]; p++) {
+        const glm::vec4 &n = Planes[p];
+        float d = n.x * (n.x > 0.0f ? maxX[i] : minX[i]) +
+                  n.y * (n.y > 0.0f ? maxY[i] : minY[i]) +
+                  n.z * (n.z > 0.0f ? maxZ[i] : minZ[i]) + n.w;
+        visible[i] = d >= 0.0f;
+      }
+    }
+  }
+};
+#endif
@@ -0,0 +1,140 @@
+/* Occlusion Class:
+ * Hardware occlusion culling of a tree's clusters (see clusters.h)
+ * - after the frame is drawn, the bounding box of every cluster in the view
+ *   frustum is rasterised against the finished depth buffer inside an
+ *   GL_ANY_SAMPLES_PASSED query (without writing colour or depth)
+ * - results are read back a frame later, only once available, so the CPU
+ *   never waits on the GPU, a cluster whose box was hidden is skipped until
+ *   its box shows up again
+ * - a box crossing the near plane (e.g. with the eye inside it) would only
+ *   rasterise its far faces, behind the cluster's own cubes, so such
+ *   clusters are never queried and always drawn
+ */
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+
+#include "../shaders/shader.h"
+#include "clusters.h"
+
+// constants -------------------------------------------------------------------
+// boxes are grown by this much on every side, so a box never ties in depth
+// with the cluster's own (already drawn) outermost faces
+const float OCCLUSION_MARGIN = 0.05f;
+
+// enums -----------------------------------------------------------------------
+// state of a cluster's query, once issued it stays pending until read back
+// - a stale query's result is read back and dropped
+enum Query_State { QUERY_NONE, QUERY_LIVE, QUERY_STALE };
+
+// class -----------------------------------------------------------------------
+class Occlusion {
+public:
+  // attributes ----------------------------------------------------------------
+  // counters of the last frame: clusters inside the view frustum, and how
+  // many of those were skipped as occluded
+  unsigned int InFrustum;
+  unsigned int Skipped;
+
+  // constructor ---------------------------------------------------------------
+  Occlusion() : InFrustum(0), Skipped(0) {}
+
+  // functions -----------------------------------------------------------------
+  // starts over for a tree with 'clusters' clusters, all assumed visible
+  void reset(size_t clusters) {
+    destroy();
+    queries.resize(clusters);
+    if (clusters)
+      glGenQueries(clusters, &queries[0]);
+    pending.assign(clusters, QUERY_NONE);
+    occluded.assign(clusters, 0);
+  }
+
+  // reads back every query result that has arrived since the last frame
+  void update() {
+    for (size_t i = 0; i < queries.size(); i++) {
+      if (pending[i] == QUERY_NONE)
+        continue;
+      GLuint available = GL_FALSE, samples = GL_TRUE;
+      glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+        continue;
+      glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &samples);
+      if (pending[i] == QUERY_LIVE)
+        occluded[i] = !samples;
+      pending[i] = QUERY_NONE;
+    }
+  }
+
+  // returns per-cluster flags of clusters to skip (see Clusters::cull)
+  const unsigned char *skip() const {
+    return occluded.empty() ? NULL : &occluded[0];
+  }
+
+  // queries the bounding box of every cluster in the frustum that has no
+  // query in flight, call after everything else has been drawn
+  // - frustum is the view volume the clusters were culled with
+  // - boxShader draws 'cubeVAO' (36 vertices of a unit cube) moved by the
+  //   'model' uniform, it is left in use
+  void query(const Clusters &clusters, const Frustum &frustum,
+             Shader &boxShader, Uniform<glm::mat4> model,
+             unsigned int cubeVAO) {
+    InFrustum = Skipped = 0;
+    boxShader.use();
+    glBindVertexArray(cubeVAO);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    for (size_t i = 0; i < clusters.size() && i < queries.size(); i++) {
+      // a cluster coming back into view is drawn until proven hidden again
+      if (!clusters.inFrustum(i)) {
+        occluded[i] = 0;
+        if (pending[i])
+          pending[i] = QUERY_STALE;
+        continue;
+      }
+      InFrustum++;
+      glm::vec3 lo = glm::vec3(clusters.MinX[i], clusters.MinY[i],
+                               clusters.MinZ[i]) - glm::vec3(OCCLUSION_MARGIN);
+      glm::vec3 hi = glm::vec3(clusters.MaxX[i], clusters.MaxY[i],
+                               clusters.MaxZ[i]) + glm::vec3(OCCLUSION_MARGIN);
+
+      // too close to query, drawn, and any query in flight is discarded
+      if (frustum.crossesNear(lo, hi)) {
+        occluded[i] = 0;
+        if (pending[i])
+          pending[i] = QUERY_STALE;
+        continue;
+      }
+      Skipped += occluded[i];
+      if (pending[i])
+        continue;
+
+      glm::mat4 box = glm::translate(glm::mat4(1.0f), (lo + hi) * 0.5f);
+      boxShader.set(model, glm::scale(box, hi - lo));
+      glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[i]);
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+      glEndQuery(GL_ANY_SAMPLES_PASSED);
+      pending[i] = QUERY_LIVE;
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+  }
+
+  // frees every query object
+  void destroy() {
+    if (!queries.empty())
+      glDeleteQueries(queries.size(), &queries[0]);
+    queries.clear();
+  }
+
+private:
+  std::vector<GLuint> queries;
+  std::vector<unsigned char> pending;  // Query_State of each cluster's query
+  std::vector<unsigned char> occluded; // box was hidden in the last result
+};
+#endif
@@ -0,0 +1,67 @@
+/* Collection of functions for growing batches of bonsai trees (a forest)
+ * - trees are grown on a work-stealing ThreadPool and never touch OpenGL
+ * - the tree with index i is always grown from seed firstSeed + i, so the
+ *   result does not depend on the number of threads
+ * - every tree of a batch is of the same species, batches of different
+ *   species may be grown at the same time
+ */
+
+#ifndef FOREST_H
+#define FOREST_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "../bonsai/bonsai.h"
+#include "../pool/pool.h"
+
+// constants -------------------------------------------------------------------
+// trees per task, large enough to amortise queueing, small enough to steal
+const size_t FOREST_CHUNK = 16;
+
+// functions -------------------------------------------------------------------
+// calls grow(index, seed) for seeds firstSeed .. firstSeed + count - 1, in
+// tasks of FOREST_CHUNK trees
+// - grow is copied into every task and called from pool threads,
+//   concurrently, in no particular order
+template <typename Grow>
+void forEachSeed(uint64_t firstSeed, size_t count, ThreadPool &pool,
+                 Grow grow) {
+  for (size_t first = 0; first < count; first += FOREST_CHUNK) {
+    size_t last = std::min(count, first + FOREST_CHUNK);
+    pool.submit([=]() mutable {
+      for (size_t i = first; i < last; i++)
+        grow(i, firstSeed + i);
+    });
+  }
+  pool.wait();
+}
+
+// grows trees with seeds firstSeed .. firstSeed + count - 1 and hands each one
+// to sink(index, tree) as soon as it is grown
+// - sink is copied into every task and called from pool threads,
+//   concurrently, in no particular order
+template <typename Sink>
+void growForest(uint64_t firstSeed, size_t count, ThreadPool &pool, Sink sink,
+                const Bonsai_Params &params = BONSAI_PRESETS[0].Params) {
+  forEachSeed(firstSeed, count, pool,
+              [=](size_t i, uint64_t seed) mutable {
+                Bonsai tree(seed, params);
+                sink(i, tree);
+              });
+}
+
+// grows trees with seeds firstSeed .. firstSeed + count - 1 into a vector
+// - every task writes only to its own, pre-sized slots of the result
+inline std::vector<Bonsai>
+growForest(uint64_t firstSeed, size_t count, ThreadPool &pool,
+           const Bonsai_Params &params = BONSAI_PRESETS[0].Params) {
+  std::vector<Bonsai> trees(count, Bonsai(0, false));
+  Bonsai *slots = count ? &trees[0] : NULL;
+  growForest(firstSeed, count, pool,
+             [slots](size_t i, Bonsai &tree) { slots[i] = std::move(tree); },
+             params);
+  return trees;
+}
+#endif
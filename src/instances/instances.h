@@ -0,0 +1,128 @@
+/* Instances Class:
+ * Uploads a list of voxels (packed cube positions and birth ticks) once into
+ * a per-instance vertex buffer so the whole list can be drawn with a single
+ * instanced draw call, the growth animation is then done entirely in the
+ * vertex shader
+ * - the same buffer can also be drawn as one point per cube, for a geometry
+ *   shader to expand into faces (see shaders/voxelgs)
+ */
+
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include <glad/glad.h>
+#include <vector>
+
+#include "../bonsai/voxel.h"
+
+// constants -------------------------------------------------------------------
+// vertex attribute locations (0 - 2 are taken by the cube's own vertices)
+const unsigned int OFFSET_ATTRIBUTE = 3;
+const unsigned int DATA_ATTRIBUTE = 4;
+
+// class -----------------------------------------------------------------------
+class Instances {
+public:
+  // attributes ----------------------------------------------------------------
+  unsigned int VAO;
+  unsigned int PointVAO;
+  unsigned int VBO;
+  unsigned int Count;
+
+  // constructor ---------------------------------------------------------------
+  // - cubeVBO holds the 36 cube vertices shared by every instance
+  // - stride is the length of one cube vertex in bytes
+  Instances(unsigned int cubeVBO, int stride) : Count(0), pointed(1) {
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+
+    // per-vertex attributes: positions, normals and texture coords
+    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    // per-instance attributes, advanced once per cube drawn
+    // - cube offset, unpacked by OpenGL from the voxel's 10:10:10 position
+    // - birth tick and material, read as one unsigned integer
+    pointInstances(0);
+    glEnableVertexAttribArray(OFFSET_ATTRIBUTE);
+    glVertexAttribDivisor(OFFSET_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(DATA_ATTRIBUTE);
+    glVertexAttribDivisor(DATA_ATTRIBUTE, 1);
+
+    // point vertex array, the same attributes advanced once per point
+    glGenVertexArrays(1, &PointVAO);
+    glBindVertexArray(PointVAO);
+    glVertexAttribPointer(OFFSET_ATTRIBUTE, 4, GL_INT_2_10_10_10_REV, GL_FALSE,
+                          sizeof(Voxel), (void *)0);
+    glEnableVertexAttribArray(OFFSET_ATTRIBUTE);
+    glVertexAttribIPointer(DATA_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(Voxel),
+                           (void *)sizeof(uint32_t));
+    glEnableVertexAttribArray(DATA_ATTRIBUTE);
+
+    glBindVertexArray(0);
+  }
+
+  // functions -----------------------------------------------------------------
+  // replaces the instance buffer contents, only needed when the list changes
+  // - voxels are uploaded as is, 8 bytes per cube
+  void upload(const std::vector<Voxel> &voxels) {
+    Count = voxels.size();
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, Count * sizeof(Voxel),
+                 Count ? &voxels[0] : NULL, GL_STATIC_DRAW);
+  }
+
+  // draws 'count' cubes starting at cube 'first' in one call
+  // - OpenGL 3.3 has no base instance, so the per-instance attributes are
+  //   re-pointed at the first cube instead
+  void draw(unsigned int first, unsigned int count) {
+    if (count == 0)
+      return;
+    glBindVertexArray(VAO);
+    pointInstances(first);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, count);
+  }
+
+  // draws 'count' cubes starting at cube 'first' as one point each
+  void drawPoints(unsigned int first, unsigned int count) {
+    if (count == 0)
+      return;
+    glBindVertexArray(PointVAO);
+    glDrawArrays(GL_POINTS, first, count);
+  }
+
+  // frees the buffer and vertex arrays
+  void destroy() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &PointVAO);
+    glDeleteBuffers(1, &VBO);
+  }
+
+private:
+  // cube the per-instance attributes currently start at
+  unsigned int pointed;
+
+  // points the per-instance attributes of the bound VAO at cube 'first'
+  // - cube offset, unpacked by OpenGL from the voxel's 10:10:10 position
+  // - birth tick and material, read as one unsigned integer
+  void pointInstances(unsigned int first) {
+    if (first == pointed)
+      return;
+    pointed = first;
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    size_t offset = first * sizeof(Voxel);
+    glVertexAttribPointer(OFFSET_ATTRIBUTE, 4, GL_INT_2_10_10_10_REV, GL_FALSE,
+                          sizeof(Voxel), (void *)offset);
+    glVertexAttribIPointer(DATA_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(Voxel),
+                           (void *)(offset + sizeof(uint32_t)));
+  }
+};
+#endif
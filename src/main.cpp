@@ -5,6 +5,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <stdlib.h>
 #include <time.h>
@@ -13,9 +15,15 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "bonsai/bonsai.h"
 #include "camera/camera.h"
+#include "culling/clusters.h"
+#include "culling/occlusion.h"
+#include "instances/instances.h"
+#include "mesher/meshbuffer.h"
+#include "mesher/mesher.h"
 #include "shaders/shader.h"
+#include "shaders/uniformbuffer.h"
 #include "stb_image.h"
-#include "texture/texture.h"
+#include "texture/textureloader.h"
 #include "utils/utils.h"
 
 using namespace std;
@@ -26,22 +34,53 @@ void framebufferSizeCallback(GLFWwindow *window, int width, int height);
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
-void renderCubeArray(vector<glm::vec3> cubeArray, Shader shader,
-                     unsigned int tick, unsigned int texture);
-void configureVertexObjects(unsigned int &VBO, unsigned int &cubeVAO,
-                            unsigned int &lightCubeVAO);
-
-// constants
+bool keyPressed(GLFWwindow *window, int key);
+void uploadTree(Instances &instances, MeshBuffer *meshes,
+                Occlusion &occlusion);
+void showFrameStats(GLFWwindow *window, const Occlusion *occlusion);
+float farPlane(glm::vec3 eye, const Occupancy &grid);
+void swapInGrownTree();
+void configureVertexObjects(unsigned int &VBO, unsigned int &lightCubeVAO);
+
+// constants & enums
 // -------------------------------------------------------------------
+// bonsai rendering modes
+// - INSTANCED draws every cube and animates growth
+// - MESHED draws the fully grown tree as greedy meshes with hidden faces culled
+// - POINTS submits one point per cube, expanded by a geometry shader into only
+//   the (at most three) faces turned towards the camera
+enum Render_Mode { INSTANCED, MESHED, POINTS };
+const int RENDER_MODES = 3;
+
+// a fully grown bonsai together with its greedy meshes and its cubes grouped
+// into culling clusters, i.e. everything that is needed to upload it to the GPU
+// - built off the render thread, then moved into place between frames
+struct Grown_Tree {
+  Bonsai Tree;
+  Mesh Meshes[VOXEL_MATERIALS];
+  Clusters Clustered;
+
+  Grown_Tree() : Tree(0, false) {}
+  Grown_Tree(uint64_t seed, const Bonsai_Params &params)
+      : Tree(seed, params), Clustered(Tree) {
+    Mesher mesher(Tree, std::thread::hardware_concurrency());
+    for (int i = 0; i < VOXEL_MATERIALS; i++)
+      Meshes[i] = std::move(mesher.Meshes[i]);
+  }
+};
+
 // screen settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
 // camera settings
+// - the far plane is pushed out to the tree's furthest corner when needed
 Camera camera(glm::vec3(0.0f, 20.0f, 60.0f));
+const float NEAR_PLANE = 0.1f, MIN_FAR_PLANE = 100.0f;
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+bool keyHeld[GLFW_KEY_LAST + 1] = {false};
 
 // timing
 float deltaTime = 0.0f;
@@ -50,10 +89,20 @@ unsigned int tick = 0;
 
 // lighting
 glm::vec3 lightPos(0.0f, 30.0f, 0.0f);
+glm::vec3 lightAmbient(0.7f, 0.7f, 0.7f);
+glm::vec3 lightDiffuse(1.3f, 1.3f, 1.3f);
+glm::vec3 lightSpecular(1.0f, 1.0f, 1.0f);
+float shininess = 64.0f; // material shininess
 float red = 0.02f, green = 0.02f, blue = 0.03f, alpha = 1.0f;
 
 // bonsai
-Bonsai tree;
+// - 'tree' is the one being rendered, 'nextTree' the one growing in the
+//   background (if any), which replaces it once ready
+Grown_Tree tree;
+std::future<Grown_Tree> nextTree;
+Bonsai_Params species = BONSAI_PRESETS[0].Params; // of every tree grown
+bool treeChanged = true; // tree needs to be (re-)uploaded to the GPU
+Render_Mode renderMode = INSTANCED;
 
 /*
    ________
@@ -111,8 +160,23 @@ float vertices[] = {
 };
 
 // main ------------------------------------------------------------------------
-int main() {
-  srand(time(NULL));
+int main(int argc, char *argv[]) {
+  // (optional) regrow a previous tree from its seed, e.g. ./bonsai 1234, and
+  // pick a species by preset name, e.g. ./bonsai 1234 shrub
+  if (argc > 2) {
+    const Bonsai_Params *preset = findPreset(argv[2]);
+    if (!preset) {
+      std::cout << "Unknown species: " << argv[2] << ", one of:";
+      for (int i = 0; i < BONSAI_PRESET_COUNT; i++)
+        std::cout << " " << BONSAI_PRESETS[i].Name;
+      std::cout << std::endl;
+      return 1;
+    }
+    species = *preset;
+  }
+  uint64_t seed = (argc > 1) ? strtoull(argv[1], NULL, 10) : randomSeed();
+  tree = Grown_Tree(seed, species);
+  std::cout << "Bonsai seed: " << tree.Tree.getSeed() << std::endl;
 
   initialize_glfw(3, 3);
   GLFWwindow *window = create_context("Bonsai", SCR_HEIGHT, SCR_WIDTH);
@@ -128,25 +192,66 @@ int main() {
   glEnable(GL_DEPTH_TEST);
 
   // build and compile shader programs from the following
-  Shader lightingShader("src/shaders/shadervs", "src/shaders/shaderfs");
+  // - the bonsai's lighting shader comes in a variant per rendering mode, all
+  //   without specular (unused) and with translation-only model matrices
+  ShaderVariants lightingShaders("src/shaders/shadervs",
+                                 "src/shaders/shaderfs");
+  unsigned int defines = SHADER_NO_SPECULAR | SHADER_TRANSLATION_ONLY;
+  ShaderVariants pointShaders("src/shaders/voxelvs", "src/shaders/shaderfs",
+                              "src/shaders/voxelgs");
+  Shader *lightingShader[] = {&lightingShaders.get(defines | SHADER_INSTANCED),
+                              &lightingShaders.get(defines),
+                              &pointShaders.get(defines)};
   Shader lightCubeShader("src/shaders/sourcevs", "src/shaders/sourcefs");
 
-  // configure cube VBO and VBA
-  unsigned int VBO, cubeVAO, lightCubeVAO;
-  configureVertexObjects(VBO, cubeVAO, lightCubeVAO);
+  // resolve the per-object uniforms set every frame (indexed by Render_Mode)
+  Uniform<glm::mat4> modelUniform[] = {
+      lightingShader[INSTANCED]->uniform<glm::mat4>("model"),
+      lightingShader[MESHED]->uniform<glm::mat4>("model"),
+      lightingShader[POINTS]->uniform<glm::mat4>("model")};
+  Uniform<float> tickUniform[] = {
+      lightingShader[INSTANCED]->uniform<float>("tick"), Uniform<float>(),
+      lightingShader[POINTS]->uniform<float>("tick")};
+  Uniform<glm::mat4> lightModelUniform =
+      lightCubeShader.uniform<glm::mat4>("model");
+
+  // configure uniform blocks shared by both programs
+  // - camera data changes every frame, light and material data almost never
+  UniformBuffer<Camera_Block> cameraBlock(CAMERA_BINDING);
+  UniformBuffer<Lighting_Block> lightingBlock(LIGHTING_BINDING);
 
-  // load in textures (diffuse map + specular map for lighting)
-  unsigned int bark = loadTexture("img/log.jpg");
-  unsigned int leaf = loadTexture("img/leaf.png");
-  unsigned int pot = loadTexture("img/pot.jpg");
-  unsigned int soil = loadTexture("img/moss.jpg");
+  // configure cube VBO and VBA
+  unsigned int VBO, lightCubeVAO;
+  configureVertexObjects(VBO, lightCubeVAO);
+
+  // configure one per-instance buffer for all bonsai cubes, every cube
+  // carries its material (see voxel.h)
+  int stride = VERTEX_LENGTH * sizeof(float);
+  Instances instances(VBO, stride);
+
+  // configure mesh buffers for each bonsai material
+  // - indexed by material: branch, leaf, soil, pot
+  MeshBuffer meshes[VOXEL_MATERIALS];
+
+  // load in textures as the layers of one texture array (same order as above)
+  // - from the baked cache (make textures) if present, else the images are
+  //   decoded in the background while plain colours stand in for them
+  const char *texturePaths[VOXEL_MATERIALS] = {"img/log.jpg", "img/leaf.png",
+                                               "img/moss.jpg", "img/pot.jpg"};
+  const unsigned char textureColors[VOXEL_MATERIALS][4] = {
+      {92, 64, 44, 255}, {72, 120, 56, 255}, {70, 92, 48, 255},
+      {150, 84, 58, 255}};
+  TextureLoader textures(texturePaths, VOXEL_MATERIALS, textureColors);
 
   // assign texture units to samplers
-  lightingShader.use();
-  lightingShader.setInt("texture", 0);
-  lightingShader.setInt("texture", 1);
-  lightingShader.setInt("texture", 2);
-  lightingShader.setInt("texture", 3);
+  for (int i = 0; i < RENDER_MODES; i++) {
+    lightingShader[i]->use();
+    lightingShader[i]->setInt("material.diffuse", 0);
+  }
+
+  // cube ranges of the clusters that passed frustum and occlusion culling
+  std::vector<Cluster_Range> visibleRanges;
+  Occlusion occlusion;
 
   // render loop ---------------------------------------------------------------
   while (!glfwWindowShouldClose(window)) {
@@ -159,47 +264,85 @@ int main() {
     // process user input
     processInput(window);
 
+    // swap in a newly grown tree, if one finished since the last frame
+    swapInGrownTree();
+
+    // upload cube positions only when the tree has changed
+    if (treeChanged) {
+      uploadTree(instances, meshes, occlusion);
+      treeChanged = false;
+    }
+
     // render background
     glClearColor(red, green, blue, alpha); // black
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // activate shader for setting uniforms/drawing objects
-    lightingShader.use();
-    lightingShader.configure(camera.Position, lightPos);
-
-    // set projection
+    // update shared uniform blocks (skipped if nothing changed)
     float fovy = glm::radians(camera.Zoom);
     float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
-    glm::mat4 projection = glm::perspective(fovy, aspect, 0.1f, 100.0f);
-    lightingShader.setMat4("projection", projection);
-
-    // set view matrix
     glm::mat4 view = camera.GetViewMatrix();
-    lightingShader.setMat4("view", view);
+    // the eye is taken from the view matrix, as the rotating camera orbits
+    // without moving camera.Position (lighting and point faces need it)
+    glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+    glm::mat4 projection = glm::perspective(
+        fovy, aspect, NEAR_PLANE, farPlane(eye, tree.Tree.Grid));
+    cameraBlock.update(Camera_Block(projection, view, eye));
+    Frustum frustum(projection * view);
+    lightingBlock.update(Lighting_Block(lightPos, lightAmbient, lightDiffuse,
+                                        lightSpecular, shininess));
+
+    // activate shader for setting uniforms/drawing objects
+    Shader &shader = *lightingShader[renderMode];
+    shader.use();
 
     // world transformation
     glm::mat4 model = glm::mat4(1.0f);
-    lightingShader.setMat4("model", model);
+    shader.set(modelUniform[renderMode], model);
+
+    // growth animation, cubes born after the current tick are hidden
+    // - meshes are never animated, their shader has no tick
+    if (renderMode != MESHED)
+      shader.set(tickUniform[renderMode], (float)tick);
 
     // bind and render objects -------------------------------------------------
-    // bonsai objects
-    glBindVertexArray(cubeVAO);
-    renderCubeArray(tree.BranchPositions, lightingShader, tick, bark);
-    renderCubeArray(tree.LeafPositions, lightingShader, tick, leaf);
-    renderCubeArray(tree.SoilPositions, lightingShader, tick, soil);
-    renderCubeArray(tree.PotPositions, lightingShader, tick, pot);
+    // bonsai objects, the shader picks each cube's texture layer by material
+    // - instanced/points: a draw call per run of clusters inside the view
+    //   frustum, as cube instances or as points
+    // - meshed: one draw call per material, passed as a constant attribute
+    glActiveTexture(GL_TEXTURE0);
+    textures.update();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textures.texture());
+    if (renderMode == MESHED) {
+      for (int i = 0; i < VOXEL_MATERIALS; i++) {
+        glVertexAttribI1ui(DATA_ATTRIBUTE, i);
+        meshes[i].draw();
+      }
+    } else {
+      occlusion.update();
+      tree.Clustered.cull(frustum, visibleRanges, occlusion.skip());
+      for (size_t i = 0; i < visibleRanges.size(); i++) {
+        if (renderMode == POINTS)
+          instances.drawPoints(visibleRanges[i].First, visibleRanges[i].Count);
+        else
+          instances.draw(visibleRanges[i].First, visibleRanges[i].Count);
+      }
+    }
 
     // light object
     lightCubeShader.use();
-    lightCubeShader.setMat4("projection", projection);
-    lightCubeShader.setMat4("view", view);
     model = glm::mat4(1.0f);
     model = glm::translate(model, lightPos);
     model = glm::scale(model, glm::vec3(0.5f));
-    lightCubeShader.setMat4("model", model);
+    lightCubeShader.set(lightModelUniform, model);
     glBindVertexArray(lightCubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
+    // test cluster boxes against the finished depth buffer for next frame
+    if (renderMode != MESHED)
+      occlusion.query(tree.Clustered, frustum, lightCubeShader,
+                      lightModelUniform, lightCubeVAO);
+    showFrameStats(window, (renderMode != MESHED) ? &occlusion : NULL);
+
     // swap buffers and check for inputs
     glfwSwapBuffers(window);
     glfwPollEvents();
@@ -207,7 +350,16 @@ int main() {
   }
 
   // clean-up ------------------------------------------------------------------
-  glDeleteVertexArrays(1, &cubeVAO);
+  instances.destroy();
+  occlusion.destroy();
+  for (int i = 0; i < VOXEL_MATERIALS; i++)
+    meshes[i].destroy();
+  textures.destroy();
+  lightingShaders.destroy();
+  pointShaders.destroy();
+  glDeleteProgram(lightCubeShader.ID);
+  cameraBlock.destroy();
+  lightingBlock.destroy();
   glDeleteVertexArrays(1, &lightCubeVAO);
   glDeleteBuffers(1, &VBO);
   glfwTerminate();
@@ -234,14 +386,36 @@ void processInput(GLFWwindow *window) {
     camera.switchMode();
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) // exits
     glfwSetWindowShouldClose(window, true);
-  if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) { // creates new tree
-    Bonsai newTree;
-    tree = newTree;
-    tick = 0;
-  }
+  if (keyPressed(window, GLFW_KEY_Q) && !nextTree.valid()) // creates new tree
+    nextTree = std::async(std::launch::async, []() {
+      return Grown_Tree(randomSeed(), species);
+    });
   if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) { // re-animates tree
     tick = 0;
   }
+  if (keyPressed(window, GLFW_KEY_M)) // switches rendering mode
+    renderMode = (Render_Mode)((renderMode + 1) % RENDER_MODES);
+}
+
+// returns true only on the frame a key goes down, not while it is held
+bool keyPressed(GLFWwindow *window, int key) {
+  bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+  bool wasHeld = keyHeld[key];
+  keyHeld[key] = pressed;
+  return pressed && !wasHeld;
+}
+
+// replaces the rendered tree with the one grown in the background, if it has
+// finished growing
+// - the old tree keeps rendering until then, so frames never wait on growth
+void swapInGrownTree() {
+  if (!nextTree.valid() ||
+      nextTree.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    return;
+  tree = nextTree.get();
+  std::cout << "Bonsai seed: " << tree.Tree.getSeed() << std::endl;
+  treeChanged = true;
+  tick = 0;
 }
 
 // callbacks -------------------------------------------------------------------
@@ -283,47 +457,69 @@ void scrollCallback(GLFWwindow *window, double xoffset, double yoffset) {
 }
 
 // OpenGL helper functions -----------------------------------------------------
-// renders a vector of cube positions based on current tick
-// - number of cubes rendered equals the current tick, this animates the model
-void renderCubeArray(vector<glm::vec3> cubeArray, Shader shader,
-                     unsigned int tick, unsigned int texture) {
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  for (unsigned int i = 0; i < tick && i < cubeArray.size(); i++) {
-    // calc model matrix for each object and pass it to shader before drawing
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, cubeArray[i]);
-    shader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+// uploads every cube of the current tree into the instance buffer (grouped
+// by cluster) and each greedy mesh (already built with the tree) into its
+// mesh buffer
+// - cubes are offset and animated in the vertex shader by comparing their
+//   birth tick to the current tick, so a cluster range is a single draw call
+void uploadTree(Instances &instances, MeshBuffer *meshes,
+                Occlusion &occlusion) {
+  instances.upload(tree.Clustered.Voxels);
+  occlusion.reset(tree.Clustered.size());
+  for (int i = 0; i < VOXEL_MATERIALS; i++)
+    meshes[i].upload(tree.Meshes[i]);
+}
+
+// shows the mean frame time (to compare rendering modes) in the window title,
+// along with how many clusters occlusion culling skipped when culling is on
+// (occlusion is NULL otherwise), updated about once a second
+void showFrameStats(GLFWwindow *window, const Occlusion *occlusion) {
+  static float lastUpdate = 0.0f;
+  static int frames = 0;
+  frames++;
+  if (lastFrame - lastUpdate < 1.0f)
+    return;
+  float frameTime = 1000.0f * (lastFrame - lastUpdate) / frames;
+  lastUpdate = lastFrame;
+  frames = 0;
+  char title[128];
+  if (occlusion)
+    snprintf(title, sizeof(title),
+             "Bonsai - clusters in view: %u, occluded: %u, %.2f ms/frame",
+             occlusion->InFrustum, occlusion->Skipped, frameTime);
+  else
+    snprintf(title, sizeof(title), "Bonsai - %.2f ms/frame", frameTime);
+  glfwSetWindowTitle(window, title);
+}
+
+// returns the distance of the far plane, far enough to see every cube of a
+// tree (with its bounding box 'grid') from 'eye'
+float farPlane(glm::vec3 eye, const Occupancy &grid) {
+  if (grid.empty())
+    return MIN_FAR_PLANE;
+  float furthest = 0.0f;
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec3 p((corner & 1) ? grid.Max.x + 0.5f : grid.Min.x - 0.5f,
+                (corner & 2) ? grid.Max.y + 0.5f : grid.Min.y - 0.5f,
+                (corner & 4) ? grid.Max.z + 0.5f : grid.Min.z - 0.5f);
+    furthest = std::max(furthest, glm::length(p - eye));
   }
+  return std::max(MIN_FAR_PLANE, furthest + 1.0f);
 }
 
 // binds and configures vertex buffer and attribute objects for each cube
-// - VBO is shared between cube and light cube
-// - VAO must be configured separately
-void configureVertexObjects(unsigned int &VBO, unsigned int &cubeVAO,
-                            unsigned int &lightCubeVAO) {
-  // configure default cubes VAO & VBO
-  glGenVertexArrays(1, &cubeVAO);
+// - VBO is shared between the bonsai cube instances and light cube
+// - bonsai cube VAOs are configured by their Instances (see instances.h), as
+//   they also carry a per-instance offset attribute:
+//   vertex = {-0.5f, -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f, 0.0f, 0.0f}
+//             -------------------  -----------   -----------------
+//                      |                |                |
+//               position coords      normals       texture coords
+void configureVertexObjects(unsigned int &VBO, unsigned int &lightCubeVAO) {
+  // configure shared cube VBO
   glGenBuffers(1, &VBO);
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  glBindVertexArray(cubeVAO);
-
-  // inform openGL how to intepret vertex attribute data, for example:
-  // vertex = {-0.5f, -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f, 0.0f, 0.0f}
-  //           -------------------  -----------   -----------------
-  //                    |                |                |
-  //             position coords      normals       texture coords
-  int len = VERTEX_LENGTH * sizeof(float);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, len, (void *)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, len,
-                        (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, len,
-                        (void *)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
 
   // configure light cube's VAO (VBO same)
   glGenVertexArrays(1, &lightCubeVAO);
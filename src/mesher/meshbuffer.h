@@ -0,0 +1,73 @@
+/* MeshBuffer Class:
+ * Uploads a Mesh (see mesher.h) into an indexed vertex array for drawing
+ */
+
+#ifndef MESHBUFFER_H
+#define MESHBUFFER_H
+
+#include <glad/glad.h>
+
+#include "mesher.h"
+
+// class -----------------------------------------------------------------------
+class MeshBuffer {
+public:
+  // attributes ----------------------------------------------------------------
+  unsigned int VAO;
+  unsigned int VBO;
+  unsigned int EBO;
+  unsigned int Count;
+
+  // constructor ---------------------------------------------------------------
+  MeshBuffer() : Count(0) {
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // same vertex layout as a cube: positions, normals and texture coords
+    int stride = MESH_VERTEX_LENGTH * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+  }
+
+  // functions -----------------------------------------------------------------
+  // replaces the buffer contents, only needed when the mesh changes
+  void upload(const Mesh &mesh) {
+    Count = mesh.Indices.size();
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, mesh.Vertices.size() * sizeof(float),
+                 Count ? &mesh.Vertices[0] : NULL, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, Count * sizeof(unsigned int),
+                 Count ? &mesh.Indices[0] : NULL, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+  }
+
+  // draws the whole mesh in one call
+  // - meshes are never animated, draw them with a non-INSTANCED shader
+  void draw() {
+    if (Count == 0)
+      return;
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, Count, GL_UNSIGNED_INT, (void *)0);
+  }
+
+  // frees the buffers and vertex array
+  void destroy() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+  }
+};
+#endif
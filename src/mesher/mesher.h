@@ -0,0 +1,237 @@
+/* Mesher Class:
+ * Builds static, greedy-meshed triangle meshes out of a bonsai's cubes
+ * - faces touching another cube can never be seen, so they are culled
+ * - visible coplanar faces of the same material are merged into larger quads
+ */
+
+#ifndef MESHER_H
+#define MESHER_H
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <thread>
+#include <vector>
+
+#include "../bonsai/bonsai.h"
+
+// constants -------------------------------------------------------------------
+// mesh vertex = {position (3), normal (3), texture coords (2)}, same as cubes
+const int MESH_VERTEX_LENGTH = 8;
+
+// structs ---------------------------------------------------------------------
+struct Mesh {
+  std::vector<float> Vertices;
+  std::vector<unsigned int> Indices;
+};
+
+// class -----------------------------------------------------------------------
+class Mesher {
+public:
+  // attributes ----------------------------------------------------------------
+  // one mesh per material, indexed by Voxel_Material
+  Mesh Meshes[VOXEL_MATERIALS];
+
+  // constructor ---------------------------------------------------------------
+  // - threads > 1 splits the slices of each face direction between threads,
+  //   the result is identical to the single-threaded one
+  Mesher(const Bonsai &tree, unsigned int threads = 1) : grid(tree.Grid) {
+    buildGrid(tree);
+    if (cells.empty())
+      return;
+
+    // each job meshes a range of slices along one face direction
+    // - slices are independent of each other so jobs never share state
+    std::vector<Job> jobs;
+    for (int face = 0; face < 6; face++) {
+      int slices = size[face / 2];
+      int chunk = std::max(1, slices / (int)std::max(1u, threads));
+      for (int first = 0; first < slices; first += chunk)
+        jobs.push_back(Job(face, first, std::min(slices, first + chunk)));
+    }
+
+    if (threads <= 1) {
+      for (unsigned int i = 0; i < jobs.size(); i++)
+        runJob(jobs[i]);
+    } else {
+      // jobs are handed out round-robin, each thread owns its jobs' output
+      std::vector<std::thread> workers;
+      for (unsigned int t = 0; t < threads; t++)
+        workers.push_back(std::thread(&Mesher::runJobs, this, &jobs, t,
+                                      threads));
+      for (unsigned int t = 0; t < workers.size(); t++)
+        workers[t].join();
+    }
+
+    // stitch job output together in job order, so the mesh is deterministic
+    for (unsigned int i = 0; i < jobs.size(); i++) {
+      for (int m = 0; m < VOXEL_MATERIALS; m++)
+        append(Meshes[m], jobs[i].Meshes[m]);
+    }
+  }
+
+  // returns total number of quads produced over all materials
+  unsigned int quadCount() const {
+    unsigned int quads = 0;
+    for (int m = 0; m < VOXEL_MATERIALS; m++)
+      quads += Meshes[m].Indices.size() / 6;
+    return quads;
+  }
+
+private:
+  // a range of slices [First, Last) along face direction Face
+  struct Job {
+    int Face, First, Last;
+    Mesh Meshes[VOXEL_MATERIALS];
+    Job(int face, int first, int last) : Face(face), First(first), Last(last) {}
+  };
+
+  // the bonsai's occupancy, used for its bounding box and neighbour tests
+  const Occupancy &grid;
+
+  // dense grid of the bonsai's bounding box, cell = material + 1 (0 = empty)
+  std::vector<unsigned char> cells;
+  glm::ivec3 origin;
+  int size[3];
+
+  // fills the dense grid from the bonsai's voxels
+  // - where cubes of different materials overlap, the last one written wins
+  void buildGrid(const Bonsai &tree) {
+    if (grid.empty())
+      return;
+
+    origin = grid.Min;
+    for (int a = 0; a < 3; a++)
+      size[a] = grid.size(a);
+    cells.assign(size[0] * size[1] * size[2], 0);
+
+    // write order decides overlaps: soil covers the pot's top layer and
+    // branches show through leaves
+    const Voxel_Material order[VOXEL_MATERIALS] = {LEAF, POT, SOIL, BRANCH};
+    for (int o = 0; o < VOXEL_MATERIALS; o++) {
+      int m = order[o];
+      for (unsigned int i = 0; i < tree.Voxels[m].size(); i++) {
+        glm::ivec3 p = tree.Voxels[m][i].cell() - origin;
+        cells[index(p[0], p[1], p[2])] = m + 1;
+      }
+    }
+  }
+
+  // thread entry point, runs every 'stride'-th job starting at 'first'
+  void runJobs(std::vector<Job> *jobs, unsigned int first,
+               unsigned int stride) {
+    for (unsigned int i = first; i < jobs->size(); i += stride)
+      runJob((*jobs)[i]);
+  }
+
+  // greedy meshes the visible faces of each slice in a job
+  // - face = axis * 2 + (0 for the negative side, 1 for the positive side)
+  // - u and v are the two axes spanning the slice
+  void runJob(Job &job) {
+    int axis = job.Face / 2, dir = (job.Face % 2) ? 1 : -1;
+    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    if (axis != 1) // keep v vertical on side faces so textures stay upright
+      std::swap(u, v);
+    int width = size[u], height = size[v];
+    std::vector<unsigned char> mask(width * height);
+
+    for (int slice = job.First; slice < job.Last; slice++) {
+      // mark faces of this slice whose neighbour in 'dir' is empty, taken a
+      // row word (64 cells along x) at a time from the occupancy grid
+      // - an x slice needs one bit of one word per row
+      std::fill(mask.begin(), mask.end(), 0);
+      glm::ivec3 lo(0), hi(size[0] - 1, size[1] - 1, size[2] - 1);
+      lo[axis] = hi[axis] = slice;
+      uint64_t keep = (axis == 0) ? 1ULL << (slice & 63) : ~0ULL;
+      for (int y = lo.y; y <= hi.y; y++) {
+        for (int z = lo.z; z <= hi.z; z++) {
+          for (int w = lo.x >> 6; w <= hi.x >> 6; w++) {
+            uint64_t bits =
+                grid.exposed(job.Face, OCCUPANCY_ANY, y, z, w) & keep;
+            for (; bits; bits &= bits - 1) {
+              glm::ivec3 c(w * 64 + lowestBit(bits), y, z);
+              mask[c[v] * width + c[u]] = cells[index(c[0], c[1], c[2])];
+            }
+          }
+        }
+      }
+
+      // merge equal faces into rectangles: grow along u, then along v
+      for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width;) {
+          unsigned char cell = mask[j * width + i];
+          if (!cell) {
+            i++;
+            continue;
+          }
+          int w = 1, h = 1;
+          while (i + w < width && mask[j * width + i + w] == cell)
+            w++;
+          while (j + h < height && rowMatches(mask, width, i, j + h, w, cell))
+            h++;
+          for (int y = j; y < j + h; y++)
+            std::fill(mask.begin() + y * width + i,
+                      mask.begin() + y * width + i + w, 0);
+
+          addQuad(job.Meshes[cell - 1], axis, dir, u, v, slice, i, j, w, h);
+          i += w;
+        }
+      }
+    }
+  }
+
+  // whether 'w' mask entries starting at (i, j) are all equal to 'cell'
+  bool rowMatches(const std::vector<unsigned char> &mask, int width, int i,
+                  int j, int w, unsigned char cell) {
+    for (int k = 0; k < w; k++) {
+      if (mask[j * width + i + k] != cell)
+        return false;
+    }
+    return true;
+  }
+
+  // appends a w * h quad lying on the 'dir' side of the given slice
+  void addQuad(Mesh &mesh, int axis, int dir, int u, int v, int slice, int i,
+               int j, int w, int h) {
+    glm::vec3 normal(0.0f);
+    normal[axis] = dir;
+
+    // corners in (u, v) order: (0, 0), (w, 0), (w, h), (0, h)
+    const int du[4] = {0, w, w, 0}, dv[4] = {0, 0, h, h};
+    unsigned int base = mesh.Vertices.size() / MESH_VERTEX_LENGTH;
+    for (int k = 0; k < 4; k++) {
+      glm::vec3 p;
+      p[axis] = origin[axis] + slice + 0.5f * dir;
+      p[u] = origin[u] + i + du[k] - 0.5f;
+      p[v] = origin[v] + j + dv[k] - 0.5f;
+      float vertex[MESH_VERTEX_LENGTH] = {p.x,      p.y,      p.z,
+                                          normal.x, normal.y, normal.z,
+                                          (float)du[k], (float)dv[k]};
+      mesh.Vertices.insert(mesh.Vertices.end(), vertex,
+                           vertex + MESH_VERTEX_LENGTH);
+    }
+
+    // wind counter-clockwise when seen from outside the cube
+    glm::vec3 eu(0.0f), ev(0.0f);
+    eu[u] = 1.0f, ev[v] = 1.0f;
+    bool ccw = glm::dot(glm::cross(eu, ev), normal) > 0.0f;
+    const unsigned int front[6] = {0, 1, 2, 2, 3, 0};
+    const unsigned int back[6] = {0, 3, 2, 2, 1, 0};
+    for (int k = 0; k < 6; k++)
+      mesh.Indices.push_back(base + (ccw ? front[k] : back[k]));
+  }
+
+  // appends one mesh to another, offsetting the appended indices
+  void append(Mesh &dst, const Mesh &src) {
+    unsigned int base = dst.Vertices.size() / MESH_VERTEX_LENGTH;
+    dst.Vertices.insert(dst.Vertices.end(), src.Vertices.begin(),
+                        src.Vertices.end());
+    for (unsigned int i = 0; i < src.Indices.size(); i++)
+      dst.Indices.push_back(base + src.Indices[i]);
+  }
+
+  int index(int x, int y, int z) const {
+    return (y * size[2] + z) * size[0] + x;
+  }
+};
+#endif
@@ -0,0 +1,141 @@
+/* ThreadPool Class:
+ * Work-stealing thread pool for CPU-side jobs (no OpenGL)
+ * - every thread owns a task queue: it pops its own newest task first, and
+ *   when it runs dry it steals the oldest task of another thread
+ * - the thread calling wait() takes part in the work as well
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// class -----------------------------------------------------------------------
+class ThreadPool {
+public:
+  // constructor ---------------------------------------------------------------
+  // - threads is the total number of threads doing work, including the one
+  //   that calls wait(), so a pool of 1 runs everything on the caller
+  ThreadPool(unsigned int threads = std::thread::hardware_concurrency())
+      : queues(threads ? threads : 1), queued(0), pending(0), stopping(false) {
+    for (unsigned int i = 1; i < queues.size(); i++)
+      workers.push_back(std::thread(&ThreadPool::work, this, i));
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+      workers[i].join();
+  }
+
+  // functions -----------------------------------------------------------------
+  // queues a task, tasks may submit further tasks while running
+  // - tasks submitted from a pool thread go to that thread's own queue
+  void submit(std::function<void()> task) {
+    pending++;
+    Queue &queue = queues[current() < 0 ? 0 : current()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(task);
+    }
+    queued++;
+    {
+      // taking the lock orders the increment before a sleeper's check
+      std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+  }
+
+  // runs tasks on the calling thread until every submitted task has finished
+  void wait() {
+    int previous = current();
+    current() = 0;
+    while (pending > 0) {
+      if (!runOne(0))
+        std::this_thread::yield();
+    }
+    current() = previous;
+  }
+
+  // number of threads doing work (including the caller of wait())
+  unsigned int size() const { return queues.size(); }
+
+  // index of the pool thread running the caller, -1 if not a pool thread
+  // - useful for indexing per-thread buffers from inside a task
+  static int &current() {
+    static thread_local int index = -1;
+    return index;
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<Queue> queues;
+  std::vector<std::thread> workers;
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<unsigned int> queued;  // tasks sitting in queues
+  std::atomic<unsigned int> pending; // tasks queued or running
+  bool stopping;                     // guarded by sleepMutex
+
+  // worker thread loop, sleeps whenever every queue is empty
+  void work(int index) {
+    current() = index;
+    while (true) {
+      if (runOne(index))
+        continue;
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      wake.wait(lock, [this] { return queued > 0 || stopping; });
+      if (stopping)
+        return;
+    }
+  }
+
+  // runs one task from our own queue, or one stolen from another queue
+  bool runOne(int index) {
+    std::function<void()> task;
+    if (!take(index, false, task)) {
+      bool stolen = false;
+      for (unsigned int i = 1; i < queues.size() && !stolen; i++)
+        stolen = take((index + i) % queues.size(), true, task);
+      if (!stolen)
+        return false;
+    }
+    task();
+    pending--;
+    return true;
+  }
+
+  // owners take their newest task (cache-warm), thieves the oldest (biggest)
+  bool take(int index, bool steal, std::function<void()> &task) {
+    Queue &queue = queues[index];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty())
+        return false;
+      if (steal) {
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+      } else {
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+      }
+    }
+    queued--;
+    return true;
+  }
+};
+#endif
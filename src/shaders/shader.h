@@ -1,17 +1,88 @@
 /* Shader Class:
- * Handles shader program compilation
+ * Handles shader program compilation and uniform access
+ * - active uniforms are looked up once after linking, hot code then sets them
+ *   through pre-resolved Uniform handles instead of by name
+ * - linked programs are cached on disk as driver binaries (where supported),
+ *   so later launches skip compiling and linking altogether
+ * - one pair of source files can be built into several variants by injecting
+ *   #defines, each draw then uses the cheapest variant correct for it
  * -- Hao X. July 2021
  */
 
 #ifndef SHADER_H
 #define SHADER_H
 
-#include <fstream>
 #include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
 #include <glm/glm.hpp>
 #include <iostream>
-#include <sstream>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <string>
+#include <sys/stat.h>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "uniformbuffer.h"
+
+// constants -------------------------------------------------------------------
+// program binaries are core in OpenGL 4.1, in 3.3 they need the extension
+// GL_ARB_get_program_binary, which glad was not generated with
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// directory program binaries are cached in (created on first use)
+const char *const SHADER_CACHE_DIR = "cache";
+
+// bump whenever the layout of a cache file changes
+const uint32_t SHADER_CACHE_VERSION = 1;
+
+// enums -----------------------------------------------------------------------
+// shader variant flags, each one defines the macro of the same name without
+// the SHADER_ prefix in every stage of the program
+// - NO_SPECULAR: skip the specular lighting term
+// - TRANSLATION_ONLY: the model matrix only translates, normals are unchanged
+// - INSTANCED: cubes are drawn instanced with per-instance offset and birth
+enum Shader_Define {
+  SHADER_NO_SPECULAR = 1 << 0,
+  SHADER_TRANSLATION_ONLY = 1 << 1,
+  SHADER_INSTANCED = 1 << 2
+};
+const int SHADER_DEFINES = 3;
+const char *const SHADER_DEFINE_NAMES[SHADER_DEFINES] = {
+    "NO_SPECULAR", "TRANSLATION_ONLY", "INSTANCED"};
+
+// structs ---------------------------------------------------------------------
+// a pre-resolved uniform location, typed by the value it is set with
+// - a location of -1 (inactive/unknown uniform) is silently ignored by OpenGL
+template <typename T> struct Uniform {
+  GLint Location;
+  Uniform(GLint location = -1) : Location(location) {}
+};
+
+// GL_ARB_get_program_binary entry points, loaded by hand
+typedef void(APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint, GLsizei, GLsizei *,
+                                                  GLenum *, void *);
+typedef void(APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint, GLenum, const void *,
+                                               GLsizei);
+typedef void(APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint, GLenum, GLint);
+
+struct Program_Binary_Api {
+  PFNGLGETPROGRAMBINARYPROC GetProgramBinary;
+  PFNGLPROGRAMBINARYPROC ProgramBinary;
+  PFNGLPROGRAMPARAMETERIPROC ProgramParameteri;
+  bool Supported;
+};
 
 // class -----------------------------------------------------------------------
 class Shader {
@@ -20,51 +91,140 @@ public:
   unsigned int ID;
 
   // constructors --------------------------------------------------------------
+  // - defines is a combination of Shader_Define flags
   Shader(const char *vertexPath, const char *fragmentPath,
-         const char *geometryPath = nullptr) {
-
-    // retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::string geometryCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    std::ifstream gShaderFile;
-
-    // ensure ifstream objects can throw exceptions
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-    try {
-      // open files
-      vShaderFile.open(vertexPath);
-      fShaderFile.open(fragmentPath);
-      std::stringstream vShaderStream, fShaderStream;
-
-      // read file's buffer contents into streams
-      vShaderStream << vShaderFile.rdbuf();
-      fShaderStream << fShaderFile.rdbuf();
-
-      // close file handlers
-      vShaderFile.close();
-      fShaderFile.close();
-
-      // convert stream into string
-      vertexCode = vShaderStream.str();
-      fragmentCode = fShaderStream.str();
-
-      // (optional) load a geometry shader
-      if (geometryPath != nullptr) {
-        gShaderFile.open(geometryPath);
-        std::stringstream gShaderStream;
-        gShaderStream << gShaderFile.rdbuf();
-        gShaderFile.close();
-        geometryCode = gShaderStream.str();
-      }
-    } catch (std::ifstream::failure &e) {
+         const char *geometryPath = nullptr, unsigned int defines = 0) {
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    // retrieve the vertex/fragment (and optional geometry) source code
+    std::string vertexCode, fragmentCode, geometryCode;
+    if (!readFile(vertexPath, vertexCode) ||
+        !readFile(fragmentPath, fragmentCode) ||
+        (geometryPath != nullptr && !readFile(geometryPath, geometryCode)))
       std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+    injectDefines(vertexCode, defines);
+    injectDefines(fragmentCode, defines);
+    injectDefines(geometryCode, defines);
+
+    // try the binary cache first, on a miss compile from source and store it
+    std::string cachePath = cacheFile(vertexCode, fragmentCode, geometryCode);
+    bool cached = loadBinary(cachePath);
+    if (!cached) {
+      compile(vertexCode, fragmentCode, geometryCode);
+      saveBinary(cachePath);
     }
+    reflectUniforms();
+
+    // share the camera and lighting blocks (if used) with all other programs
+    bindBlock(CAMERA_BLOCK, CAMERA_BINDING);
+    bindBlock(LIGHTING_BLOCK, LIGHTING_BINDING);
+
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - start)
+                    .count();
+    std::cout << "Shader " << vertexPath << " + " << fragmentPath
+              << " (defines " << defines << ")"
+              << (cached ? " loaded from cache in " : " compiled in ") << ms
+              << " ms" << std::endl;
+  }
+
+  // actives shader
+  void use() { glUseProgram(ID); }
+
+  // binds a uniform block of the program to a binding point (see
+  // uniformbuffer.h), does nothing if the program has no such block
+  void bindBlock(const char *name, unsigned int binding) {
+    GLuint index = glGetUniformBlockIndex(ID, name);
+    if (index != GL_INVALID_INDEX)
+      glUniformBlockBinding(ID, index, binding);
+  }
+
+  // uniform handles -----------------------------------------------------------
+  // returns the location of an active uniform (from the cache, no GL call)
+  // - array uniforms can be found by their plain name or "name[0]"
+  GLint location(const char *name) const {
+    std::vector<Uniform_Entry>::const_iterator it = std::lower_bound(
+        uniforms.begin(), uniforms.end(), name, compareEntry);
+    return (it != uniforms.end() && it->Name == name) ? it->Location : -1;
+  }
+
+  // returns a typed handle to a uniform, resolve these once outside of loops
+  // e.g. Uniform<glm::mat4> view = shader.uniform<glm::mat4>("view");
+  template <typename T> Uniform<T> uniform(const char *name) const {
+    return Uniform<T>(location(name));
+  }
+
+  // sets a uniform of the program in use through its handle
+  void set(Uniform<bool> u, bool value) const {
+    glUniform1i(u.Location, (int)value);
+  }
+  void set(Uniform<int> u, int value) const { glUniform1i(u.Location, value); }
+  void set(Uniform<float> u, float value) const {
+    glUniform1f(u.Location, value);
+  }
+  void set(Uniform<glm::vec2> u, const glm::vec2 &value) const {
+    glUniform2fv(u.Location, 1, &value[0]);
+  }
+  void set(Uniform<glm::vec3> u, const glm::vec3 &value) const {
+    glUniform3fv(u.Location, 1, &value[0]);
+  }
+  void set(Uniform<glm::vec4> u, const glm::vec4 &value) const {
+    glUniform4fv(u.Location, 1, &value[0]);
+  }
+  void set(Uniform<glm::mat2> u, const glm::mat2 &mat) const {
+    glUniformMatrix2fv(u.Location, 1, GL_FALSE, &mat[0][0]);
+  }
+  void set(Uniform<glm::mat3> u, const glm::mat3 &mat) const {
+    glUniformMatrix3fv(u.Location, 1, GL_FALSE, &mat[0][0]);
+  }
+  void set(Uniform<glm::mat4> u, const glm::mat4 &mat) const {
+    glUniformMatrix4fv(u.Location, 1, GL_FALSE, &mat[0][0]);
+  }
+
+  // utility uniform functions -------------------------------------------------
+  // - convenient for one-off set up, prefer handles in per-frame code
+  void setBool(const std::string &name, bool value) const {
+    glUniform1i(location(name.c_str()), (int)value);
+  }
+  void setInt(const std::string &name, int value) const {
+    glUniform1i(location(name.c_str()), value);
+  }
+  void setFloat(const std::string &name, float value) const {
+    glUniform1f(location(name.c_str()), value);
+  }
+  void setVec2(const std::string &name, const glm::vec2 &value) const {
+    glUniform2fv(location(name.c_str()), 1, &value[0]);
+  }
+  void setVec2(const std::string &name, float x, float y) const {
+    glUniform2f(location(name.c_str()), x, y);
+  }
+  void setVec3(const std::string &name, const glm::vec3 &value) const {
+    glUniform3fv(location(name.c_str()), 1, &value[0]);
+  }
+  void setVec3(const std::string &name, float x, float y, float z) const {
+    glUniform3f(location(name.c_str()), x, y, z);
+  }
+  void setVec4(const std::string &name, const glm::vec4 &value) const {
+    glUniform4fv(location(name.c_str()), 1, &value[0]);
+  }
+  void setVec4(const std::string &name, float x, float y, float z, float w) {
+    glUniform4f(location(name.c_str()), x, y, z, w);
+  }
+  void setMat2(const std::string &name, const glm::mat2 &mat) const {
+    glUniformMatrix2fv(location(name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  }
+  void setMat3(const std::string &name, const glm::mat3 &mat) const {
+    glUniformMatrix3fv(location(name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  }
+  void setMat4(const std::string &name, const glm::mat4 &mat) const {
+    glUniformMatrix4fv(location(name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  }
+
+private:
+  // compiles and links the program from source
+  void compile(const std::string &vertexCode, const std::string &fragmentCode,
+               const std::string &geometryCode) {
     const char *vShaderCode = vertexCode.c_str();
     const char *fShaderCode = fragmentCode.c_str();
 
@@ -82,8 +242,8 @@ public:
     checkCompileErrors(fragment, "FRAGMENT");
 
     /* (optional) compile geometry shaders */
-    unsigned int geometry;
-    if (geometryPath != nullptr) {
+    unsigned int geometry = 0;
+    if (!geometryCode.empty()) {
       const char *gShaderCode = geometryCode.c_str();
       geometry = glCreateShader(GL_GEOMETRY_SHADER);
       glShaderSource(geometry, 1, &gShaderCode, NULL);
@@ -95,76 +255,213 @@ public:
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
-    if (geometryPath != nullptr)
+    if (geometry)
       glAttachShader(ID, geometry);
+    if (binaryApi().Supported)
+      binaryApi().ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                    GL_TRUE);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
 
     // clean up already linked shaders
     glDeleteShader(vertex);
     glDeleteShader(fragment);
-    if (geometryPath != nullptr)
+    if (geometry)
       glDeleteShader(geometry);
   }
 
-  // actives shader
-  void use() { glUseProgram(ID); }
-
-  // configure shader
-  void configure(glm::vec3 pos, glm::vec3 lightPos) {
-    // positions
-    setVec3("light.position", lightPos);
-    setVec3("viewPos", pos);
-    // light properties
-    setVec3("light.ambient", 0.7f, 0.7f, 0.7f);
-    setVec3("light.diffuse", 1.3f, 1.3f, 1.3f);
-    setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-    // material properties
-    setFloat("material.shininess", 64.0f);
+  // adds a #define line for every flag set, right after the #version line
+  // (which has to stay the first line of the source)
+  static void injectDefines(std::string &code, unsigned int defines) {
+    if (code.empty() || !defines)
+      return;
+    std::string lines;
+    for (int i = 0; i < SHADER_DEFINES; i++) {
+      if (defines & (1u << i))
+        lines += "#define " + std::string(SHADER_DEFINE_NAMES[i]) + "\n";
+    }
+    size_t at = code.find("#version");
+    if (at == std::string::npos) {
+      at = 0;
+    } else if ((at = code.find('\n', at)) == std::string::npos) {
+      code += '\n';
+      at = code.size();
+    } else {
+      at++;
+    }
+    code.insert(at, lines);
   }
 
-  // utility uniform functions -------------------------------------------------
-  void setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
-  }
-  void setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+  // program binary cache ------------------------------------------------------
+  // loads the program binary entry points once (needs a current context)
+  static const Program_Binary_Api &binaryApi() {
+    static Program_Binary_Api api = loadBinaryApi();
+    return api;
   }
-  void setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
-  }
-  void setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+
+  static Program_Binary_Api loadBinaryApi() {
+    Program_Binary_Api api;
+    api.GetProgramBinary =
+        (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+    api.ProgramBinary =
+        (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+    api.ProgramParameteri =
+        (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+    api.Supported = false;
+    if (api.GetProgramBinary && api.ProgramBinary && api.ProgramParameteri &&
+        glfwExtensionSupported("GL_ARB_get_program_binary")) {
+      // drivers may support the extension but offer no binary formats
+      GLint formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      api.Supported = formats > 0;
+    }
+    return api;
   }
-  void setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+
+  // returns the cache file of a program, named by a 64-bit FNV-1a hash of its
+  // sources and of the driver, as binaries are only valid for the driver (and
+  // driver version) that produced them
+  static std::string cacheFile(const std::string &vertexCode,
+                               const std::string &fragmentCode,
+                               const std::string &geometryCode) {
+    uint64_t hash = 14695981039346656037ull;
+    const GLenum driver[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (int i = 0; i < 3; i++) {
+      const char *name = (const char *)glGetString(driver[i]);
+      hash = fnv1a(name ? name : "", hash);
+    }
+    hash = fnv1a(vertexCode, hash);
+    hash = fnv1a(fragmentCode, hash);
+    hash = fnv1a(geometryCode, hash);
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+    return SHADER_CACHE_DIR + std::string(name);
   }
-  void setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+
+  // hashes a string (and its end, so "ab" + "c" differs from "a" + "bc")
+  static uint64_t fnv1a(const std::string &text, uint64_t hash) {
+    for (size_t i = 0; i <= text.size(); i++) {
+      hash ^= (i < text.size()) ? (unsigned char)text[i] : 0xFF;
+      hash *= 1099511628211ull;
+    }
+    return hash;
   }
-  void setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+
+  // creates the program from a cached binary, returns false on a cache miss
+  // - binaries can be rejected by the driver (e.g. after an update), in which
+  //   case they are simply compiled again and overwritten
+  bool loadBinary(const std::string &path) {
+    if (!binaryApi().Supported)
+      return false;
+    std::string file;
+    if (!readFile(path.c_str(), file) || file.size() <= 2 * sizeof(uint32_t))
+      return false;
+
+    // file = {version, binary format, binary}
+    uint32_t header[2];
+    memcpy(header, file.data(), sizeof(header));
+    if (header[0] != SHADER_CACHE_VERSION)
+      return false;
+
+    ID = glCreateProgram();
+    binaryApi().ProgramBinary(ID, header[1], file.data() + sizeof(header),
+                              file.size() - sizeof(header));
+    GLint success = GL_FALSE;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success) {
+      glDeleteProgram(ID);
+      return false;
+    }
+    return true;
   }
-  void setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+
+  // stores the linked program's binary in the cache
+  void saveBinary(const std::string &path) {
+    GLint length = 0, success = GL_FALSE;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!binaryApi().Supported || !success)
+      return;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+      return;
+
+    uint32_t header[2] = {SHADER_CACHE_VERSION, 0};
+    std::vector<char> binary(length);
+    GLenum format;
+    binaryApi().GetProgramBinary(ID, length, &length, &format, &binary[0]);
+    header[1] = format;
+
+#ifdef _WIN32
+    _mkdir(SHADER_CACHE_DIR);
+#else
+    mkdir(SHADER_CACHE_DIR, 0755);
+#endif
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+      return;
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(&binary[0], 1, length, file);
+    fclose(file);
   }
-  void setVec4(const std::string &name, float x, float y, float z, float w) {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+
+  // reads a whole file into 'text' in one go, returns false if it can't
+  static bool readFile(const char *path, std::string &text) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+      return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    text.resize(size > 0 ? size : 0);
+    bool read = size <= 0 || fread(&text[0], 1, size, file) == (size_t)size;
+    fclose(file);
+    return read;
   }
-  void setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                       &mat[0][0]);
+
+  // an active uniform found after linking, the cache is sorted by name
+  struct Uniform_Entry {
+    std::string Name;
+    GLint Location;
+  };
+  std::vector<Uniform_Entry> uniforms;
+
+  static bool compareEntry(const Uniform_Entry &entry, const char *name) {
+    return entry.Name.compare(name) < 0;
   }
-  void setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                       &mat[0][0]);
+
+  // caches the name and location of every active uniform of the program
+  void reflectUniforms() {
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> name(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++) {
+      GLsizei length;
+      GLint size;
+      GLenum type;
+      glGetActiveUniform(ID, i, name.size(), &length, &size, &type, &name[0]);
+      Uniform_Entry entry;
+      entry.Name.assign(&name[0], length);
+      entry.Location = glGetUniformLocation(ID, &name[0]);
+      if (entry.Location < 0) // uniforms inside blocks have no location
+        continue;
+      uniforms.push_back(entry);
+
+      // arrays are reported as "name[0]", also make them findable as "name"
+      size_t suffix = entry.Name.rfind("[0]");
+      if (suffix != std::string::npos && suffix == entry.Name.size() - 3) {
+        entry.Name.erase(suffix);
+        uniforms.push_back(entry);
+      }
+    }
+    std::sort(uniforms.begin(), uniforms.end(), compareNames);
   }
-  void setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                       &mat[0][0]);
+
+  static bool compareNames(const Uniform_Entry &a, const Uniform_Entry &b) {
+    return a.Name < b.Name;
   }
 
-private:
   // check for compilation errors
   void checkCompileErrors(GLuint shader, std::string type) {
     GLint success;
@@ -192,4 +489,42 @@ private:
     }
   }
 };
+
+// ShaderVariants Class --------------------------------------------------------
+// builds variants of one program on first use and keeps them for later draws
+// - there are at most 2^SHADER_DEFINES variants, so a small map is plenty
+class ShaderVariants {
+public:
+  // constructor ---------------------------------------------------------------
+  ShaderVariants(const char *vertexPath, const char *fragmentPath,
+                 const char *geometryPath = nullptr)
+      : vertexPath(vertexPath), fragmentPath(fragmentPath),
+        geometryPath(geometryPath) {}
+
+  // functions -----------------------------------------------------------------
+  // returns the variant with the given Shader_Define flags, the reference
+  // stays valid for the lifetime of this object
+  Shader &get(unsigned int defines) {
+    std::map<unsigned int, Shader>::iterator it = variants.find(defines);
+    if (it == variants.end())
+      it = variants
+               .insert(std::make_pair(defines,
+                                      Shader(vertexPath, fragmentPath,
+                                             geometryPath, defines)))
+               .first;
+    return it->second;
+  }
+
+  // deletes every variant built so far
+  void destroy() {
+    std::map<unsigned int, Shader>::iterator it;
+    for (it = variants.begin(); it != variants.end(); it++)
+      glDeleteProgram(it->second.ID);
+    variants.clear();
+  }
+
+private:
+  const char *vertexPath, *fragmentPath, *geometryPath;
+  std::map<unsigned int, Shader> variants;
+};
 #endif
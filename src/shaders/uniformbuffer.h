@@ -0,0 +1,85 @@
+/* UniformBuffer Class:
+ * Holds a std140 uniform block in a buffer bound to a fixed binding point, so
+ * every shader program using the block reads the same data
+ * - the block is only re-uploaded when its contents change
+ */
+
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string.h>
+
+// constants -------------------------------------------------------------------
+// uniform block names and the binding points they are bound to in every program
+const char *const CAMERA_BLOCK = "Camera";
+const char *const LIGHTING_BLOCK = "Lighting";
+const unsigned int CAMERA_BINDING = 0;
+const unsigned int LIGHTING_BINDING = 1;
+
+// structs ---------------------------------------------------------------------
+// std140 layouts of the shared blocks, these must match the shaders exactly
+// - a vec3 takes up as much space as a vec4, so vec4s are used as padding
+struct Camera_Block {
+  glm::mat4 Projection;
+  glm::mat4 View;
+  glm::vec4 ViewPos;
+
+  Camera_Block(const glm::mat4 &projection, const glm::mat4 &view,
+               const glm::vec3 &viewPos)
+      : Projection(projection), View(view), ViewPos(viewPos, 1.0f) {}
+};
+
+struct Lighting_Block {
+  glm::vec4 Position;
+  glm::vec4 Ambient;
+  glm::vec4 Diffuse;
+  glm::vec4 Specular;
+  float Shininess;
+  float Padding[3];
+
+  Lighting_Block(const glm::vec3 &position, const glm::vec3 &ambient,
+                 const glm::vec3 &diffuse, const glm::vec3 &specular,
+                 float shininess)
+      : Position(position, 1.0f), Ambient(ambient, 0.0f),
+        Diffuse(diffuse, 0.0f), Specular(specular, 0.0f),
+        Shininess(shininess) {
+    Padding[0] = Padding[1] = Padding[2] = 0.0f;
+  }
+};
+
+// class -----------------------------------------------------------------------
+template <typename Block> class UniformBuffer {
+public:
+  // attributes ----------------------------------------------------------------
+  unsigned int UBO;
+  unsigned int Binding;
+
+  // constructor ---------------------------------------------------------------
+  UniformBuffer(unsigned int binding) : Binding(binding), uploaded(false) {
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, Binding, UBO);
+  }
+
+  // functions -----------------------------------------------------------------
+  // writes the block into the buffer, unless it is unchanged since last time
+  void update(const Block &block) {
+    if (uploaded && memcmp(&data, &block, sizeof(Block)) == 0)
+      return;
+    memcpy(&data, &block, sizeof(Block));
+    uploaded = true;
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &data);
+  }
+
+  void destroy() { glDeleteBuffers(1, &UBO); }
+
+private:
+  // last uploaded contents (raw bytes, blocks have no default constructor)
+  unsigned char data[sizeof(Block)];
+  bool uploaded;
+};
+#endif
@@ -2,9 +2,15 @@
  * -- Hao X. July 2021
  */
 
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <iostream>
 
+#include "texturecache.h"
+
 // utility function for loading a 2D texture from file
 unsigned int loadTexture(char const *path) {
   unsigned int textureID;
@@ -39,4 +45,47 @@ unsigned int loadTexture(char const *path) {
   }
 
   return textureID;
-}
\ No newline at end of file
+}
+
+// utility function for loading a texture array baked by tools/bake, mip
+// levels are uploaded straight from the (memory-mapped) file
+// - returns 0 if the file is missing, damaged or doesn't hold 'layers' layers
+//   of TEXTURE_LAYER_SIZE, so the caller can fall back to decoding the
+//   images (see TextureLoader)
+unsigned int loadTextureCache(const char *path, int layers) {
+  MappedFile file(path);
+  Texture_Cache_Header header;
+  if (file.Size < sizeof(header))
+    return 0;
+  memcpy(&header, file.Data, sizeof(header));
+  if (memcmp(header.Magic, TEXTURE_CACHE_MAGIC, 4) != 0 ||
+      header.Version != TEXTURE_CACHE_VERSION ||
+      header.Size != (uint32_t)TEXTURE_LAYER_SIZE ||
+      header.Layers != (uint32_t)layers || header.Levels == 0)
+    return 0;
+  size_t bytes = sizeof(header);
+  for (uint32_t level = 0; level < header.Levels; level++)
+    bytes += textureLevelBytes(header.Size, header.Layers, level);
+  if (file.Size < bytes)
+    return 0;
+
+  unsigned int textureID;
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+  const unsigned char *data = file.Data + sizeof(header);
+  for (uint32_t level = 0; level < header.Levels; level++) {
+    int side = std::max(1u, header.Size >> level);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, side, side, layers, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, data);
+    data += textureLevelBytes(header.Size, header.Layers, level);
+  }
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, header.Levels - 1);
+
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  return textureID;
+}
+#endif
@@ -0,0 +1,134 @@
+/* Texture Cache:
+ * Raw, pre-mipmapped texture array container baked offline (see tools/bake)
+ * - file = header, then every mip level (largest first), each level holding
+ *   all layers back to back as RGBA8, i.e. exactly what glTexImage3D takes
+ * - the file is memory-mapped where possible so levels upload straight from
+ *   the page cache, with no decoding or mipmap generation at startup
+ */
+
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// constants -------------------------------------------------------------------
+// side length every layer of a texture array is resized to
+const int TEXTURE_LAYER_SIZE = 512;
+
+// baked texture array of the bonsai materials, built by 'make textures'
+const char *const TEXTURE_CACHE_PATH = "img/textures.bin";
+const char TEXTURE_CACHE_MAGIC[4] = {'B', 'T', 'E', 'X'};
+
+// bump whenever the layout of the container changes
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+// structs ---------------------------------------------------------------------
+struct Texture_Cache_Header {
+  char Magic[4];
+  uint32_t Version;
+  uint32_t Size;   // side length of mip level 0, a power of two
+  uint32_t Layers; // number of images
+  uint32_t Levels; // number of mip levels, down to 1 x 1
+};
+
+// functions -------------------------------------------------------------------
+// returns the number of bytes of one mip level (all layers)
+inline size_t textureLevelBytes(uint32_t size, uint32_t layers,
+                                uint32_t level) {
+  size_t side = std::max(1u, size >> level);
+  return side * side * 4 * layers;
+}
+
+// resizes an RGBA image to size x size, every output texel is the average of
+// the source texels it covers (at least one)
+inline void resizeImage(const unsigned char *src, int width, int height,
+                        unsigned char *dst, int size) {
+  for (int y = 0; y < size; y++) {
+    int y0 = y * height / size, y1 = std::max(y0 + 1, (y + 1) * height / size);
+    for (int x = 0; x < size; x++) {
+      int x0 = x * width / size, x1 = std::max(x0 + 1, (x + 1) * width / size);
+      unsigned int sum[4] = {0, 0, 0, 0};
+      for (int sy = y0; sy < y1; sy++) {
+        for (int sx = x0; sx < x1; sx++) {
+          for (int c = 0; c < 4; c++)
+            sum[c] += src[(sy * width + sx) * 4 + c];
+        }
+      }
+      unsigned int count = (y1 - y0) * (x1 - x0);
+      for (int c = 0; c < 4; c++)
+        dst[(y * size + x) * 4 + c] = (sum[c] + count / 2) / count;
+    }
+  }
+}
+
+// class -----------------------------------------------------------------------
+// a read-only view of a whole file, memory-mapped if the platform allows it
+// and read into memory otherwise
+class MappedFile {
+public:
+  // attributes ----------------------------------------------------------------
+  const unsigned char *Data;
+  size_t Size;
+
+  // constructor ---------------------------------------------------------------
+  MappedFile(const char *path) : Data(NULL), Size(0), mapped(NULL) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+      struct stat info;
+      if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+          mapped = map;
+          Data = (const unsigned char *)map;
+          Size = info.st_size;
+        }
+      }
+      ::close(fd);
+      if (mapped)
+        return;
+    }
+#endif
+    // fallback: read the file into memory
+    FILE *file = fopen(path, "rb");
+    if (!file)
+      return;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0) {
+      buffer.resize(size);
+      if (fread(&buffer[0], 1, size, file) == (size_t)size) {
+        Data = &buffer[0];
+        Size = size;
+      }
+    }
+    fclose(file);
+  }
+
+  ~MappedFile() {
+#ifndef _WIN32
+    if (mapped)
+      munmap(mapped, Size);
+#endif
+  }
+
+private:
+  void *mapped;
+  std::vector<unsigned char> buffer;
+
+  // owns the mapping, so it can't be copied
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+};
+#endif
@@ -0,0 +1,161 @@
+/* TextureLoader Class:
+ * Loads the layers of a texture array without stalling the render loop
+ * - images are decoded and resized on worker threads, straight into mapped
+ *   pixel buffer objects, the render thread then only has to hand each
+ *   buffer to glTexSubImage3D (which copies it asynchronously)
+ * - a 1 x 1 placeholder array (one colour per layer) is drawn with until
+ *   every layer has landed
+ * - a baked texture cache (see texturecache.h) is used instead when present,
+ *   it needs no decoding so it is loaded right away
+ */
+
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <algorithm>
+#include <future>
+#include <glad/glad.h>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+#include "texture.h"
+
+// class -----------------------------------------------------------------------
+class TextureLoader {
+public:
+  // constructor ---------------------------------------------------------------
+  // - layer i is loaded from paths[i], colors[i] is its RGBA placeholder
+  // - paths must stay valid until every layer has been loaded
+  TextureLoader(const char *const *paths, int layers,
+                const unsigned char (*colors)[4], int size = TEXTURE_LAYER_SIZE)
+      : paths(paths), layers(layers), size(size), remaining(0),
+        placeholder(0) {
+    textureID = loadTextureCache(TEXTURE_CACHE_PATH, layers);
+    if (textureID)
+      return;
+
+    // placeholder array, one texel per layer
+    glGenTextures(1, &placeholder);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, placeholder);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, layers, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, colors);
+    setParameters(GL_NEAREST);
+
+    // real array, filled in layer by layer
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layers, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    // one mapped pixel buffer per layer, each decoded into by its own thread
+    pbos.resize(layers);
+    decoded.resize(layers);
+    glGenBuffers(layers, &pbos[0]);
+    for (int i = 0; i < layers; i++) {
+      startLayer(i);
+      remaining++;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  // functions -----------------------------------------------------------------
+  // uploads every layer decoded since the last call, call once per frame
+  // - a buffer whose contents were lost while mapped (glUnmapBuffer fails,
+  //   e.g. on a display mode change) is decoded into again and uploaded on a
+  //   later frame
+  // - returns true once every layer has been loaded
+  bool update() {
+    if (remaining == 0)
+      return true;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    for (int i = 0; i < layers; i++) {
+      if (!decoded[i].valid() || decoded[i].wait_for(std::chrono::seconds(0)) !=
+                                     std::future_status::ready)
+        continue;
+      decoded[i].get();
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+      if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+        startLayer(i);
+        continue;
+      }
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size, size, 1, GL_RGBA,
+                      GL_UNSIGNED_BYTE, (void *)0);
+      remaining--;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (remaining > 0)
+      return false;
+
+    // every layer landed, the placeholder and pixel buffers can go
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    setParameters(GL_LINEAR_MIPMAP_LINEAR);
+    glDeleteBuffers(layers, &pbos[0]);
+    std::vector<unsigned int>().swap(pbos);
+    glDeleteTextures(1, &placeholder);
+    placeholder = 0;
+    return true;
+  }
+
+  // returns the texture array to draw with, the placeholder until loaded
+  unsigned int texture() const { return remaining ? placeholder : textureID; }
+
+  // frees the textures, waiting for any layer still being decoded
+  void destroy() {
+    for (size_t i = 0; i < decoded.size(); i++) {
+      if (decoded[i].valid())
+        decoded[i].wait();
+    }
+    if (!pbos.empty())
+      glDeleteBuffers(layers, &pbos[0]);
+    glDeleteTextures(1, &textureID);
+    if (placeholder)
+      glDeleteTextures(1, &placeholder);
+  }
+
+private:
+  const char *const *paths;
+  unsigned int textureID;
+  int layers, size, remaining;
+  unsigned int placeholder;
+  std::vector<unsigned int> pbos;
+  std::vector<std::future<void> > decoded;
+
+  // (re)allocates and maps the pixel buffer of a layer, then decodes its
+  // image into it on a worker, the buffer is left bound
+  void startLayer(int i) {
+    size_t bytes = (size_t)size * size * 4;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    unsigned char *pixels = (unsigned char *)glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    decoded[i] = std::async(std::launch::async, decode, paths[i], pixels, size);
+  }
+
+  // decodes an image into 'pixels' (size x size RGBA), runs on a worker
+  // - images that fail to load leave their layer black
+  static void decode(const char *path, unsigned char *pixels, int size) {
+    if (!pixels)
+      return;
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 4);
+    if (data) {
+      resizeImage(data, width, height, pixels, size);
+    } else {
+      std::cout << "Texture failed to load at path: " << path << std::endl;
+      memset(pixels, 0, (size_t)size * size * 4);
+    }
+    stbi_image_free(data);
+  }
+
+  // sets wrapping and filtering of the bound texture array
+  static void setParameters(GLint minFilter) {
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER,
+                    minFilter == GL_NEAREST ? GL_NEAREST : GL_LINEAR);
+  }
+};
+#endif
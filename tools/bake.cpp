@@ -0,0 +1,75 @@
+/* Texture Bake Tool:
+ * Decodes images once, offline, into a raw pre-mipmapped texture array (see
+ * src/texture/texturecache.h), one layer per image in the order given
+ * usage: ./tools/bake [output] [images...]
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../src/stb_image.h"
+#include "../src/texture/texturecache.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    cout << "usage: " << argv[0] << " [output] [images...]" << endl;
+    return 1;
+  }
+  uint32_t size = TEXTURE_LAYER_SIZE, layers = argc - 2, levels = 1;
+  while ((size >> (levels - 1)) > 1)
+    levels++;
+
+  // level 0: every image converted to RGBA and resized
+  vector<vector<unsigned char> > mips(levels);
+  mips[0].resize(textureLevelBytes(size, layers, 0));
+  for (uint32_t i = 0; i < layers; i++) {
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(argv[i + 2], &width, &height,
+                                    &nrComponents, 4);
+    if (!data) {
+      cout << "Texture failed to load at path: " << argv[i + 2] << endl;
+      return 1;
+    }
+    resizeImage(data, width, height, &mips[0][i * size * size * 4], size);
+    stbi_image_free(data);
+  }
+
+  // every further level halves the previous one (2 x 2 box filter)
+  for (uint32_t level = 1; level < levels; level++) {
+    uint32_t from = size >> (level - 1), to = size >> level;
+    mips[level].resize(textureLevelBytes(size, layers, level));
+    for (uint32_t i = 0; i < layers; i++)
+      resizeImage(&mips[level - 1][i * from * from * 4], from, from,
+                  &mips[level][i * to * to * 4], to);
+  }
+
+  // write header and levels
+  Texture_Cache_Header header;
+  memcpy(header.Magic, TEXTURE_CACHE_MAGIC, 4);
+  header.Version = TEXTURE_CACHE_VERSION;
+  header.Size = size;
+  header.Layers = layers;
+  header.Levels = levels;
+  FILE *file = fopen(argv[1], "wb");
+  if (!file) {
+    cout << "Failed to open output: " << argv[1] << endl;
+    return 1;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (uint32_t level = 0; level < levels; level++)
+    written = written &&
+              fwrite(&mips[level][0], 1, mips[level].size(), file) ==
+                  mips[level].size();
+  if (fclose(file) != 0 || !written) {
+    cout << "Failed to write output: " << argv[1] << endl;
+    remove(argv[1]);
+    return 1;
+  }
+  cout << "Baked " << layers << " layers, " << levels << " levels of " << size
+       << "x" << size << " into " << argv[1] << endl;
+  return 0;
+}